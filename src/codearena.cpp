@@ -0,0 +1,136 @@
+#include "codearena.hpp"
+
+#include "log.hpp"
+#include "memory.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+//Older kernels ignore unknown flags, which turns the address into a hint. map() checks the result either way
+#ifndef MAP_FIXED_NOREPLACE
+	#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+CCodeArena::CCodeArena()
+{
+	this->base = LM_ADDRESS_BAD;
+	this->size = 0;
+	this->hotNext = LM_ADDRESS_BAD;
+	this->coldNext = LM_ADDRESS_BAD;
+}
+
+bool CCodeArena::map(lm_address_t address)
+{
+	void* mem = mmap
+	(
+		reinterpret_cast<void*>(address),
+		ARENA_SIZE,
+		PROT_READ | PROT_WRITE | PROT_EXEC,
+		MAP_PRIVATE | MAP_ANONYMOUS | (address ? MAP_FIXED_NOREPLACE : 0),
+		-1,
+		0
+	);
+
+	if (mem == MAP_FAILED)
+	{
+		return false;
+	}
+
+	if (address && reinterpret_cast<lm_address_t>(mem) != address)
+	{
+		munmap(mem, ARENA_SIZE);
+		return false;
+	}
+
+	base = reinterpret_cast<lm_address_t>(mem);
+	size = ARENA_SIZE;
+	Memory::add(Memory::Subsystem::Hooks, size);
+	hotNext = base;
+	coldNext = base + size;
+	return true;
+}
+
+bool CCodeArena::init(const lm_module_t& module)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (base != LM_ADDRESS_BAD)
+	{
+		return true;
+	}
+
+	const lm_address_t pageSize = sysconf(_SC_PAGESIZE);
+	const lm_address_t moduleEnd = (module.end + pageSize - 1) & ~(pageSize - 1);
+	const lm_address_t moduleBase = module.base & ~(pageSize - 1);
+
+	//Directly behind or in front of the module if possible, otherwise the closest free gap we find
+	bool mapped = false;
+	for(lm_address_t distance = 0; !mapped && distance < 64 * ARENA_SIZE; distance += ARENA_SIZE)
+	{
+		mapped = map(moduleEnd + distance) || (moduleBase > distance + ARENA_SIZE && map(moduleBase - distance - ARENA_SIZE));
+	}
+
+	if (!mapped && !map(0))
+	{
+		g_pLog->debug("Unable to map code arena!\n");
+		return false;
+	}
+
+	g_pLog->debug("Mapped code arena at %p-%p next to %s at %p-%p\n", base, base + size, module.name, module.base, module.end);
+	return true;
+}
+
+lm_address_t CCodeArena::alloc(size_t size, bool hot)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (base == LM_ADDRESS_BAD)
+	{
+		return LM_ADDRESS_BAD;
+	}
+
+	size = (size + SLOT_ALIGNMENT - 1) & ~(SLOT_ALIGNMENT - 1);
+	if (coldNext - hotNext < size)
+	{
+		g_pLog->debug("Code arena is full!\n");
+		return LM_ADDRESS_BAD;
+	}
+
+	lm_address_t slot;
+	if (hot)
+	{
+		slot = hotNext;
+		hotNext += size;
+	}
+	else
+	{
+		coldNext -= size;
+		slot = coldNext;
+	}
+
+	//int3 so jumping into unused parts of a slot traps instead of sliding into the next one
+	memset(reinterpret_cast<void*>(slot), 0xCC, size);
+	return slot;
+}
+
+void CCodeArena::release()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (base == LM_ADDRESS_BAD)
+	{
+		return;
+	}
+
+	munmap(reinterpret_cast<void*>(base), size);
+	Memory::sub(Memory::Subsystem::Hooks, size);
+	g_pLog->debug("Released code arena at %p\n", base);
+
+	base = LM_ADDRESS_BAD;
+	hotNext = LM_ADDRESS_BAD;
+	coldNext = LM_ADDRESS_BAD;
+}
+
+CCodeArena g_codeArena = CCodeArena();
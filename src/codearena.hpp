@@ -0,0 +1,35 @@
+#pragma once
+
+#include "libmem/libmem.h"
+
+#include <cstddef>
+#include <mutex>
+
+///Summary:
+///Executable memory for trampolines and stubs, reserved right next to steamclient.so.
+///Hot code gets packed from the start and everything else from the end, so the code running on
+///every hooked call shares as few cache lines and pages as possible. Only freed as a whole
+class CCodeArena
+{
+	lm_address_t base;
+	size_t size;
+	lm_address_t hotNext;
+	lm_address_t coldNext;
+	std::mutex mutex;
+
+	bool map(lm_address_t address);
+
+public:
+	static constexpr size_t ARENA_SIZE = 16 * 1024;
+	static constexpr size_t SLOT_ALIGNMENT = 64; //Cache line
+
+	CCodeArena();
+
+	bool init(const lm_module_t& module);
+	///Summary:
+	///Returns cache line aligned, writable and executable memory or LM_ADDRESS_BAD when full
+	lm_address_t alloc(size_t size, bool hot);
+	void release();
+};
+
+extern CCodeArena g_codeArena;
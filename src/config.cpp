@@ -1,4 +1,7 @@
 #include "config.hpp"
+#include "probes.hpp"
+#include "statspage.hpp"
+#include "tracer.hpp"
 
 #include "yaml-cpp/yaml.h"
 
@@ -6,8 +9,14 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <filesystem>
+#include <iterator>
+#include <map>
 #include <string>
+#include <sys/inotify.h>
+#include <thread>
+#include <unistd.h>
 
 //TODO: Move into own .yaml file somehow
 static const char* defaultConfig = 
@@ -43,8 +52,41 @@ static const char* defaultConfig =
 "#Warn user via notification when steamclient.so hash differs from known safe hash\n"
 "#Mostly useful for development so I don't accidentally miss an update\n"
 "WarnHashMissmatch: no\n\n"
+"#Always hash steamclient.so during start instead of reusing the last hash while the file did not change\n"
+"ParanoidHashCheck: no\n\n"
 "#Logs all calls to Steamworks (this makes the logfile huge! Only useful for debugging/analyzing\n"
-"ExtendedLogging: no";
+"ExtendedLogging: no\n\n"
+"#Additionally writes how long each startup phase took to startup-timing.json next to this config\n"
+"StartupTimingJson: no\n\n"
+"#Seconds between logging call counts and latencies of every hook. 0 disables collecting them\n"
+"HookStatsInterval: 0\n\n"
+"#Publishes live counters in /dev/shm/SLSsteam-<pid> for the slsstat tool\n"
+"StatsPage: no\n\n"
+"#Names SLSsteam's trampolines and stubs for perf in /tmp/perf-<pid>.map\n"
+"PerfMap: no\n\n"
+"#Additionally writes /tmp/jit-<pid>.dump for perf inject --jit. Requires PerfMap\n"
+"PerfJitDump: no\n\n"
+"#Records every hook call for this many seconds and writes them to trace.json next to this config.\n"
+"#Open it in ui.perfetto.dev. 0 disables tracing\n"
+"TraceDuration: 0\n\n"
+"#Seconds to wait after SLSsteam loaded before recording starts\n"
+"TraceDelay: 0\n\n"
+"#Seconds between logging the most frequent Steam pipe calls. Much cheaper than ExtendedLogging. 0 disables it\n"
+"PipeProfileInterval: 0\n\n"
+"#How many pipe calls each PipeProfile report lists\n"
+"PipeProfileTop: 20\n\n"
+"#Records every ownership and DLC hook call for this many seconds to hooks.slsrec next to this config.\n"
+"#Replay it with slsreplay. 0 disables recording\n"
+"RecordDuration: 0\n\n"
+"#KiB of memory each part of SLSsteam may keep allocated before something is done about it. 0 is unlimited.\n"
+"#Log drops its cache of already written messages, everything else gets a warning.\n"
+"#Current usage gets logged with HookStatsInterval and when Steam exits\n"
+"MemoryBudgets:\n"
+"  Log: 4096\n"
+"  Config: 0\n"
+"  Hooks: 0\n"
+"  Caches: 0\n"
+"  Profiling: 0";
 
 std::string CConfig::getDir()
 {
@@ -81,7 +123,7 @@ bool CConfig::createFile()
 				return false;
 			}
 
-			g_pLog->debug("Created config directory at %s\n");
+			g_pLog->debug("Created config directory at %s\n", dir.c_str());
 		}
 
 		FILE* file = fopen(path.c_str(), "w");
@@ -107,11 +149,47 @@ bool CConfig::init()
 }
 
 bool CConfig::loadSettings()
+{
+	return loadSettings(getPath());
+}
+
+void CConfig::parseLiveSettings(YAML::Node node, bool quiet)
+{
+	disableFamilyLock = getSetting<bool>(node, "DisableFamilyShareLock", true, quiet);
+	extendedLogging = getSetting<bool>(node, "ExtendedLogging", false, quiet);
+	hookStatsInterval = getOptionalSetting<unsigned int>(node, "HookStatsInterval", 0, quiet);
+	pipeProfileInterval = getOptionalSetting<unsigned int>(node, "PipeProfileInterval", 0, quiet);
+	pipeProfileTop = getOptionalSetting<unsigned int>(node, "PipeProfileTop", 20, quiet);
+
+	//Subsystems missing from MemoryBudgets are unlimited
+	const auto budgets = getOptionalSetting<std::map<std::string, unsigned int>>(node, "MemoryBudgets", { { "Log", 4096 } }, quiet);
+	//Filled in first, so a reload never shows hooks a budget of 0 in between
+	unsigned int parsed[Memory::SUBSYSTEMS] {};
+	for(auto& [name, budget] : budgets)
+	{
+		unsigned int i = 0;
+		while(i < Memory::SUBSYSTEMS && name != Memory::subsystemToStr(static_cast<Memory::Subsystem>(i)))
+		{
+			i++;
+		}
+
+		if (i < Memory::SUBSYSTEMS)
+			parsed[i] = budget;
+		else if (!quiet)
+			g_pLog->notify("Unknown MemoryBudgets entry %s!", name.c_str());
+	}
+	for(unsigned int i = 0; i < Memory::SUBSYSTEMS; i++)
+	{
+		memoryBudgets[i] = parsed[i];
+	}
+}
+
+bool CConfig::loadSettings(const std::string& path)
 {
 	YAML::Node node;
 	try
 	{
-		node = YAML::LoadFile(getPath());
+		node = YAML::LoadFile(path);
 	}
 	catch (YAML::BadFile& bf)
 	{
@@ -124,22 +202,44 @@ bool CConfig::loadSettings()
 		node = YAML::Node(); //Create empty node and let defaults kick in
 	}
 	
-	disableFamilyLock = getSetting<bool>(node, "DisableFamilyShareLock", true);
+	parseLiveSettings(node, false);
 	useWhiteList = getSetting<bool>(node, "UseWhitelist", false);
 	automaticFilter = getSetting<bool>(node, "AutoFilterList", true);
 	playNotOwnedGames = getSetting<bool>(node, "PlayNotOwnedGames", false);
 	safeMode = getSetting<bool>(node, "SafeMode", false);
 	warnHashMissmatch = getSetting<bool>(node, "WarnHashMissmatch", false);
-	extendedLogging = getSetting<bool>(node, "ExtendedLogging", false);
+	paranoidHashCheck = getOptionalSetting<bool>(node, "ParanoidHashCheck", false);
+	startupTimingJson = getOptionalSetting<bool>(node, "StartupTimingJson", false);
+	statsPage = getOptionalSetting<bool>(node, "StatsPage", false);
+	perfMap = getOptionalSetting<bool>(node, "PerfMap", false);
+	perfJitDump = getOptionalSetting<bool>(node, "PerfJitDump", false);
+	traceDuration = getOptionalSetting<unsigned int>(node, "TraceDuration", 0);
+	traceDelay = getOptionalSetting<unsigned int>(node, "TraceDelay", 0);
+	recordDuration = getOptionalSetting<unsigned int>(node, "RecordDuration", 0);
 
 	//TODO: Create smart logging function to log them automatically via getSetting
-	g_pLog->info("DisableFamilyShareLock: %i\n", disableFamilyLock);
+	g_pLog->info("DisableFamilyShareLock: %i\n", disableFamilyLock.load());
 	g_pLog->info("UseWhitelist: %i\n", useWhiteList);
 	g_pLog->info("AutoFilterList: %i\n", automaticFilter);
 	g_pLog->info("PlayNotOwnedGames: %i\n", playNotOwnedGames);
 	g_pLog->info("SafeMode: %i\n", safeMode);
 	g_pLog->info("WarnHashMissmatch: %i\n", warnHashMissmatch);
-	g_pLog->info("ExtendedLogging: %i\n", extendedLogging);
+	g_pLog->info("ParanoidHashCheck: %i\n", paranoidHashCheck);
+	g_pLog->info("ExtendedLogging: %i\n", extendedLogging.load());
+	g_pLog->info("StartupTimingJson: %i\n", startupTimingJson);
+	g_pLog->info("HookStatsInterval: %u\n", hookStatsInterval.load());
+	g_pLog->info("StatsPage: %i\n", statsPage);
+	g_pLog->info("PerfMap: %i\n", perfMap);
+	g_pLog->info("PerfJitDump: %i\n", perfJitDump);
+	g_pLog->info("TraceDuration: %u\n", traceDuration);
+	g_pLog->info("TraceDelay: %u\n", traceDelay);
+	g_pLog->info("PipeProfileInterval: %u\n", pipeProfileInterval.load());
+	g_pLog->info("PipeProfileTop: %u\n", pipeProfileTop.load());
+	g_pLog->info("RecordDuration: %u\n", recordDuration);
+	for(unsigned int i = 0; i < Memory::SUBSYSTEMS; i++)
+	{
+		g_pLog->info("MemoryBudgets %s: %u\n", Memory::subsystemToStr(static_cast<Memory::Subsystem>(i)), memoryBudgets[i].load());
+	}
 
 	//TODO: Create function to parse these kinda nodes, instead of c+p them
 	const auto appIdsNode = node["AppIds"];
@@ -205,7 +305,7 @@ bool CConfig::loadSettings()
 					//There's more efficient types to store strings, but they mostly do not work
 					const std::string dlcName = dlc.second.as<std::string>();
 
-					data.dlcIds[dlcId] = dlcName;
+					data.dlcIds[dlcId] = dlcName.c_str();
 					g_pLog->debug("DlcId %u -> %s\n", dlcId, dlcName.c_str());
 				}
 
@@ -223,6 +323,88 @@ bool CConfig::loadSettings()
 		g_pLog->notify("Missing DlcData entry in config!\n");
 	}
 
+	const uint32_t generation = StatsPage::get()->configGeneration.fetch_add(1, std::memory_order_relaxed) + 1;
+	SLS_PROBE(config_loaded, generation, appIds.size(), addedAppIds.size(), dlcData.size());
+	return true;
+}
+
+bool CConfig::reload()
+{
+	//Only the live options get parsed again. Everything else would repeat the load time notifications
+	//and hooks read the lists without locking anyway
+	YAML::Node node;
+	try
+	{
+		node = YAML::LoadFile(getPath());
+	}
+	catch (YAML::Exception& ex)
+	{
+		//Editors might still be writing it, the next write triggers another reload
+		g_pLog->debug("Unable to reload config: %s\n", ex.msg.c_str());
+		return false;
+	}
+
+	parseLiveSettings(node, true);
+
+	g_pLog->info("Reloaded config. DisableFamilyShareLock, ExtendedLogging, HookStatsInterval, PipeProfile* and MemoryBudgets got applied, everything else needs a restart\n");
+	return true;
+}
+
+bool CConfig::watch(void(*onReload)())
+{
+	int fd = inotify_init1(IN_CLOEXEC);
+	if (fd < 0)
+	{
+		g_pLog->debug("Unable to create inotify instance!\n");
+		return false;
+	}
+
+	//Watching the directory, since most editors replace the file instead of writing to it
+	const std::string dir = getDir();
+	if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		g_pLog->debug("Unable to watch %s!\n", dir.c_str());
+		close(fd);
+		return false;
+	}
+
+	std::thread([this, fd, onReload]()
+	{
+		alignas(inotify_event) char buf[4096];
+		for(;;)
+		{
+			const ssize_t len = read(fd, buf, sizeof(buf));
+			if (len <= 0)
+			{
+				break;
+			}
+
+			bool changed = false;
+			for(ssize_t offset = 0; offset < len; )
+			{
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(buf + offset);
+				if (event->len && strcmp(event->name, "config.yaml") == 0)
+				{
+					changed = true;
+				}
+
+				offset += sizeof(inotify_event) + event->len;
+			}
+
+			if (!changed)
+				continue;
+
+			Tracer::CScope scope("Config reload");
+			if (reload())
+			{
+				onReload();
+			}
+		}
+
+		close(fd);
+	}).detach();
+
+	g_pLog->debug("Watching %s for config changes\n", dir.c_str());
 	return true;
 }
 
@@ -260,4 +442,15 @@ bool CConfig::shouldExcludeAppId(uint32_t appId)
 	return exclude;
 }
 
+const std::pair<const uint32_t, CConfig::CString>* CConfig::getDlcByIndex(uint32_t appId, int dlcIndex)
+{
+	const auto data = dlcData.find(appId);
+	if (data == dlcData.end() || dlcIndex < 0 || static_cast<size_t>(dlcIndex) >= data->second.dlcIds.size())
+	{
+		return nullptr;
+	}
+
+	return &*std::next(data->second.dlcIds.begin(), dlcIndex);
+}
+
 CConfig g_config = CConfig();
@@ -1,51 +1,86 @@
 #pragma once
 
 #include "log.hpp"
+#include "memory.hpp"
 
 #include "yaml-cpp/exceptions.h"
 #include "yaml-cpp/node/node.h"
 
+#include <atomic>
 #include <cstdint>
 #include <cstdio>
 #include <pthread.h>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 
 class CConfig {
 public:
+	//AdditionalApps grows while Steam runs, so everything parsed from the config counts towards Config
+	template<typename T>
+	using CAllocator = Memory::CAllocator<T, Memory::Subsystem::Config>;
+	typedef std::basic_string<char, std::char_traits<char>, CAllocator<char>> CString;
+	typedef std::unordered_set<uint32_t, std::hash<uint32_t>, std::equal_to<uint32_t>, CAllocator<uint32_t>> CAppIdSet;
+
 	class CDlcData
 	{
 	public:
 		uint32_t parentId;
-		std::unordered_map<uint32_t, std::string> dlcIds;
+		std::unordered_map<uint32_t, CString, std::hash<uint32_t>, std::equal_to<uint32_t>, CAllocator<std::pair<const uint32_t, CString>>> dlcIds;
 		//No default constructor, otherwise dlcData will complain that no matching one was found
 		//without implementing it ourself anyway
 	};
 
-	std::unordered_set<uint32_t> appIds;
-	std::unordered_set<uint32_t> addedAppIds;
-	std::unordered_map<uint32_t, CDlcData> dlcData;
+	CAppIdSet appIds;
+	CAppIdSet addedAppIds;
+	std::unordered_map<uint32_t, CDlcData, std::hash<uint32_t>, std::equal_to<uint32_t>, CAllocator<std::pair<const uint32_t, CDlcData>>> dlcData;
 
-	bool disableFamilyLock;
+	//Atomic ones get applied live by reload(), everything else needs a restart
+	std::atomic<bool> disableFamilyLock;
 	bool useWhiteList;
 	bool automaticFilter;
 	bool playNotOwnedGames;
 	bool safeMode;
 	bool warnHashMissmatch;
-	bool extendedLogging;
+	bool paranoidHashCheck;
+	std::atomic<bool> extendedLogging;
+	bool startupTimingJson;
+	std::atomic<unsigned int> hookStatsInterval;
+	bool statsPage;
+	bool perfMap;
+	bool perfJitDump;
+	unsigned int traceDuration;
+	unsigned int traceDelay;
+	std::atomic<unsigned int> pipeProfileInterval;
+	std::atomic<unsigned int> pipeProfileTop;
+	unsigned int recordDuration;
+	std::atomic<unsigned int> memoryBudgets[Memory::SUBSYSTEMS]; //KiB, 0 is unlimited
 
 	std::string getDir();
 	std::string getPath();
 	bool createFile();
 	bool init();
 
+	///Summary:
+	///Parses every option reload() applies live into this. Only logs when not quiet
+	void parseLiveSettings(YAML::Node node, bool quiet);
 	bool loadSettings();
-	template<typename T> T getSetting(YAML::Node node, const char* name, T defVal)
+	bool loadSettings(const std::string& path);
+	///Summary:
+	///Parses the config again and applies the options which are safe to change while Steam runs
+	bool reload();
+	///Summary:
+	///Calls onReload after every reload() caused by config.yaml being written to
+	bool watch(void(*onReload)());
+	///Summary:
+	///quiet skips the notifications about missing or broken entries
+	template<typename T> T getSetting(YAML::Node node, const char* name, T defVal, bool quiet = false)
 	{
 		if (!node[name])
 		{
-			g_pLog->notifyLong("Missing %s in configfile! Using default", name);
+			if (!quiet)
+				g_pLog->notifyLong("Missing %s in configfile! Using default", name);
 			return defVal;
 		}
 
@@ -55,15 +90,31 @@ public:
 		}
 		catch (YAML::BadConversion& er)
 		{
-			g_pLog->notify("Failed to parse value of %s! Using default\n", name);
+			if (!quiet)
+				g_pLog->notify("Failed to parse value of %s! Using default\n", name);
 			return defVal;
 		}
 	};
 
+	///Summary:
+	///For opt-in options added after release. Older configs lack them, so only a value which fails to parse gets reported
+	template<typename T> T getOptionalSetting(YAML::Node node, const char* name, T defVal, bool quiet = false)
+	{
+		if (!node[name])
+		{
+			return defVal;
+		}
+
+		return getSetting<T>(node, name, defVal, quiet);
+	};
+
 	bool isAddedAppId(uint32_t appId);
 	bool addAdditionalAppId(uint32_t appId);
 
 	bool shouldExcludeAppId(uint32_t appId);
+	///Summary:
+	///Returns the dlcIndex'th DLC of appId's DlcData or nullptr if there is none
+	const std::pair<const uint32_t, CString>* getDlcByIndex(uint32_t appId, int dlcIndex);
 };
 
 extern CConfig g_config;
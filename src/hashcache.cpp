@@ -0,0 +1,126 @@
+#include "hashcache.hpp"
+
+#include "config.hpp"
+#include "log.hpp"
+#include "statspage.hpp"
+#include "utils.hpp"
+
+#include "yaml-cpp/yaml.h"
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+
+class CFileIdentity
+{
+public:
+	uint64_t device;
+	uint64_t inode;
+	uint64_t size;
+	uint64_t mtimeNs;
+	uint64_t ctimeNs;
+
+	bool operator==(const CFileIdentity&) const = default;
+};
+
+static bool getFileIdentity(const char* filePath, CFileIdentity& identity)
+{
+	struct stat st;
+	if (stat(filePath, &st) != 0)
+	{
+		return false;
+	}
+
+	identity.device = st.st_dev;
+	identity.inode = st.st_ino;
+	identity.size = st.st_size;
+	identity.mtimeNs = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+	identity.ctimeNs = static_cast<uint64_t>(st.st_ctim.tv_sec) * 1000000000 + st.st_ctim.tv_nsec;
+
+	return true;
+}
+
+std::string HashCache::getPath()
+{
+	return g_config.getDir().append("/hashcache.yaml");
+}
+
+std::string HashCache::getFileSHA256(const char* filePath, bool paranoid)
+{
+	//Both the hash verification and the signature cache might ask for it at the same time
+	static std::mutex mutex;
+	std::lock_guard<std::mutex> lock(mutex);
+
+	CFileIdentity identity;
+	if (paranoid || !getFileIdentity(filePath, identity))
+	{
+		return Utils::getFileSHA256(filePath);
+	}
+
+	YAML::Node node;
+	try
+	{
+		node = YAML::LoadFile(getPath());
+
+		const auto fileNode = node[filePath];
+		if (fileNode)
+		{
+			CFileIdentity cached;
+			cached.device = fileNode["Device"].as<uint64_t>();
+			cached.inode = fileNode["Inode"].as<uint64_t>();
+			cached.size = fileNode["Size"].as<uint64_t>();
+			cached.mtimeNs = fileNode["MTimeNs"].as<uint64_t>();
+			cached.ctimeNs = fileNode["CTimeNs"].as<uint64_t>();
+
+			if (cached == identity)
+			{
+				const std::string sha256 = fileNode["SHA256"].as<std::string>();
+				g_pLog->debug("Using cached hash of %s\n", filePath);
+				StatsPage::get()->hashCacheHits.fetch_add(1, std::memory_order_relaxed);
+				return sha256;
+			}
+
+			g_pLog->debug("%s changed since it was last hashed\n", filePath);
+		}
+	}
+	catch (YAML::Exception& ex)
+	{
+		//Missing or broken, we'll just write a new one
+		g_pLog->debug("Unable to read hash cache: %s\n", ex.msg.c_str());
+		node = YAML::Node();
+	}
+
+	const std::string sha256 = Utils::getFileSHA256(filePath);
+	StatsPage::get()->hashCacheMisses.fetch_add(1, std::memory_order_relaxed);
+
+	//Only cache when the file did not change while we were hashing it
+	CFileIdentity after;
+	if (!getFileIdentity(filePath, after) || !(after == identity))
+	{
+		return sha256;
+	}
+
+	YAML::Node fileNode;
+	fileNode["Device"] = identity.device;
+	fileNode["Inode"] = identity.inode;
+	fileNode["Size"] = identity.size;
+	fileNode["MTimeNs"] = identity.mtimeNs;
+	fileNode["CTimeNs"] = identity.ctimeNs;
+	fileNode["SHA256"] = sha256;
+	node[filePath] = fileNode;
+
+	std::ofstream file(getPath(), std::ios::out | std::ios::trunc);
+	if (file.is_open())
+	{
+		file << node << "\n";
+	}
+	else
+	{
+		g_pLog->debug("Unable to write hash cache to %s!\n", getPath().c_str());
+	}
+
+	return sha256;
+}
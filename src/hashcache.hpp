@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+///Summary:
+///Remembers the SHA256 of files by their identity (device, inode, size, mtime & ctime),
+///so unchanged files like steamclient.so don't have to be hashed on every start
+namespace HashCache
+{
+	std::string getPath();
+
+	///Summary:
+	///Returns the cached hash of filePath if its identity did not change, otherwise hashes and caches it.
+	///Always hashes when paranoid is set. Taken as parameter, since callers may run before the config got loaded.
+	///Throws std::runtime_error like Utils::getFileSHA256
+	std::string getFileSHA256(const char* filePath, bool paranoid);
+}
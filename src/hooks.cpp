@@ -1,10 +1,24 @@
+#include "codearena.hpp"
 #include "config.hpp"
 #include "globals.hpp"
 #include "hooks.hpp"
+#include "hookstats.hpp"
 #include "log.hpp"
 #include "memhlp.hpp"
+#include "memory.hpp"
+#include "patcher.hpp"
 #include "patterns.hpp"
+#include "perfmap.hpp"
+#include "pipeprofiler.hpp"
+#include "policy.hpp"
+#include "probes.hpp"
+#include "recorder.hpp"
+#include "rtti.hpp"
+#include "sigcache.hpp"
+#include "timing.hpp"
+#include "tracer.hpp"
 #include "vftableinfo.hpp"
+#include "x86.hpp"
 
 #include "libmem/libmem.h"
 
@@ -17,23 +31,29 @@
 #include <cstdio>
 #include <cstring>
 #include <iterator>
-#include <map>
 #include <memory>
+#include <mutex>
 #include <pthread.h>
 #include <strings.h>
 #include <unistd.h>
+#include <utility>
 #include <vector>
 
 template<typename T>
 Hook<T>::Hook(const char* name)
 {
 	this->name = std::string(name);
+	this->statsId = HookStats::registerHook(this->name.c_str());
 }
 
 template<typename T>
-DetourHook<T>::DetourHook(const char* name) : Hook<T>::Hook(name)
+DetourHook<T>::DetourHook(const char* name, T hookFn) : Hook<T>::Hook(name)
 {
+	this->hookFn.fn = hookFn;
+	this->tramp.address = LM_ADDRESS_BAD;
 	this->size = 0;
+	this->hot = false;
+	this->placed = false;
 }
 
 template<typename T>
@@ -43,7 +63,7 @@ VFTHook<T>::VFTHook(const char* name) : Hook<T>::Hook(name)
 }
 
 template<typename T>
-bool DetourHook<T>::setup(const char* pattern, const MemHlp::SigFollowMode followMode, T hookFn)
+bool DetourHook<T>::setup(const char* pattern, MemHlp::SigFollowMode followMode, bool hot)
 {
 	//Hardcoding g_modSteamClient here is definitely bad design, but we can easily change that
 	//in case we ever need to
@@ -54,39 +74,141 @@ bool DetourHook<T>::setup(const char* pattern, const MemHlp::SigFollowMode follo
 	}
 
 	this->originalFn.address = oFn;
-	this->hookFn.fn = hookFn;
+	this->hot = hot;
+	return true;
+}
 
+template<typename T>
+bool DetourHook<T>::setup(lm_address_t fn, bool hot)
+{
+	if (fn == LM_ADDRESS_BAD)
+	{
+		return false;
+	}
+
+	this->originalFn.address = fn;
+	this->hot = hot;
 	return true;
 }
 
 template<typename T>
-void DetourHook<T>::place()
+template<typename ...Args>
+auto DetourHook<T>::callOriginal(Args... args)
 {
-	this->size = LM_HookCode(this->originalFn.address, this->hookFn.address, &this->tramp.address);
-	MemHlp::fixPICThunkCall(this->name.c_str(), this->originalFn.address, this->tramp.address);
+	HookStats::COriginalScope stats;
+	return this->tramp.fn(args...);
+}
+
+template<typename T>
+template<typename ...Args>
+auto VFTHook<T>::callOriginal(Args... args)
+{
+	HookStats::COriginalScope stats;
+	return this->originalFn.fn(args...);
+}
+
+template<typename T>
+bool DetourHook<T>::queuePlace(CPatchTransaction& transaction)
+{
+	if (this->placed)
+	{
+		return true;
+	}
+
+	if (this->tramp.address == LM_ADDRESS_BAD)
+	{
+		{
+			Timing::CScope timing("trampolines");
+			this->tramp.address = MemHlp::createTrampoline(this->name.c_str(), this->originalFn.address, this->hot, this->size);
+		}
+
+		if (this->tramp.address == LM_ADDRESS_BAD)
+		{
+			return false;
+		}
+
+		if (PerfMap::isEnabled())
+		{
+			PerfMap::add(this->tramp.address, this->size + X86::JMP_REL32_SIZE, ("SLSsteam::tramp::" + this->name).c_str());
+		}
+
+		memcpy(this->originalBytes, reinterpret_cast<const void*>(this->originalFn.address), sizeof(this->originalBytes));
+	}
+
+	lm_byte_t jmp[X86::JMP_REL32_SIZE];
+	X86::encodeJmp(jmp, this->originalFn.address, this->hookFn.address);
+	transaction.write(this->originalFn.address, jmp, sizeof(jmp));
+
+	//Set before committing, whoever commits has to reset it if that fails
+	this->placed = true;
 
 	g_pLog->debug
 	(
-		"Detour hooked %s (%p) with hook at %p and tramp at %p\n",
+		"Detour hooking %s (%p) with hook at %p and tramp at %p\n",
 		this->name.c_str(),
 		this->originalFn.address,
 		this->hookFn.address,
 		this->tramp.address
 	);
+	return true;
 }
 
 template<typename T>
-void DetourHook<T>::remove()
+void DetourHook<T>::queueRemove(CPatchTransaction& transaction)
 {
-	if (!this->size)
+	if (!this->placed)
 	{
 		return;
 	}
 
-	LM_UnhookCode(this->originalFn.address, this->tramp.address, this->size);
+	transaction.write(this->originalFn.address, this->originalBytes, sizeof(this->originalBytes));
+	this->placed = false;
+}
+
+template<typename T>
+void DetourHook<T>::resetTrampoline()
+{
+	this->tramp.address = LM_ADDRESS_BAD;
 	this->size = 0;
+	this->placed = false;
+}
+
+template<typename T>
+void DetourHook<T>::place()
+{
+	CPatchTransaction transaction;
+	if (!queuePlace(transaction) || !transaction.commit())
+	{
+		g_pLog->debug("Failed to place %s!\n", this->name.c_str());
+		this->placed = false;
+	}
+}
+
+template<typename T>
+bool DetourHook<T>::remove()
+{
+	return remove(true);
+}
+
+template<typename T>
+bool DetourHook<T>::remove(bool live)
+{
+	if (!this->placed)
+	{
+		return true;
+	}
+
+	CPatchTransaction transaction(live);
+	queueRemove(transaction);
+	if (!transaction.commit())
+	{
+		g_pLog->debug("Failed to unhook %s!\n", this->name.c_str());
+		this->placed = true;
+		return false;
+	}
 
 	g_pLog->debug("Unhooked %s\n", this->name.c_str());
+	return true;
 }
 
 template<typename T>
@@ -105,19 +227,20 @@ void VFTHook<T>::place()
 }
 
 template<typename T>
-void VFTHook<T>::remove()
+bool VFTHook<T>::remove()
 {
 	//No clue how libmem reacts when unhooking a non existent hook
 	//so we do this
 	if (!this->hooked)
 	{
-		return;
+		return true;
 	}
 
 	LM_VmtUnhook(this->vft.get(), this->index);
 	this->hooked = false;
 
 	g_pLog->debug("Unhooked %s!\n", this->name.c_str());
+	return true;
 }
 
 template<typename T>
@@ -133,7 +256,14 @@ void VFTHook<T>::setup(std::shared_ptr<lm_vmt_t> vft, unsigned int index, T hook
 __attribute__((hot))
 static void hkLogSteamPipeCall(const char* iface, const char* fn)
 {
-	Hooks::LogSteamPipeCall.tramp.fn(iface, fn);
+	HookStats::CCallScope stats(Hooks::LogSteamPipeCall.statsId);
+	SLS_PROBE(pipe_call, iface, fn);
+	Hooks::LogSteamPipeCall.callOriginal(iface, fn);
+
+	if (PipeProfiler::isEnabled())
+	{
+		PipeProfiler::record(iface, fn);
+	}
 
 	if (g_config.extendedLogging)
 	{
@@ -141,136 +271,122 @@ static void hkLogSteamPipeCall(const char* iface, const char* fn)
 	}
 }
 
-static bool applistRequested = false;
-static auto appIdOwnerOverride = std::map<uint32_t, int>();
-
-__attribute__((hot))
-static bool hkCheckAppOwnership(void* a0, uint32_t appId, CAppOwnershipInfo* pOwnershipInfo)
+static void record(Recorder::HookId hook, uint32_t appId, uint32_t dlcId, int32_t original, int32_t decision, uint32_t arg = 0, uint32_t state = Recorder::STATE_NONE, uint8_t flags = 0)
 {
-	const bool ret = Hooks::CheckAppOwnership.tramp.fn(a0, appId, pOwnershipInfo);
-
-	//Do not log pOwnershipInfo because it gets deleted very quickly, so it's pretty much useless in the logs
-	g_pLog->once("CheckAppOwnership(%p, %u) -> %i\n", a0, appId, ret);
-
-	//Wait Until GetSubscribedApps gets called once to let Steam request and populate legit data first.
-	//Afterwards modifying should hopefully not affect false positives anymore
-	if (!applistRequested || g_config.shouldExcludeAppId(appId) || !pOwnershipInfo || !g_currentSteamId)
-	{
-		return ret;
-	}
-
-	if (g_config.isAddedAppId(appId) || (g_config.playNotOwnedGames && !pOwnershipInfo->purchased))
+	if (!Recorder::isRecording())
 	{
-		//Changing the purchased field is enough, but just for nicety in the Steamclient UI we change the owner too
-		pOwnershipInfo->ownerSteamId = g_currentSteamId;
-		pOwnershipInfo->purchased = true;
-
-		//Unnessecary but whatever
-		pOwnershipInfo->permanent = true;
-		pOwnershipInfo->familyShared = false;
-
-		//Found in backtrace
-		pOwnershipInfo->releaseState = 4;
-		pOwnershipInfo->field10_0x25 = 0;
-		//Seems to do nothing in particular, some dlc have this as 1 so I uncomented this for now. Might be free stuff?
-		//pOwnershipInfo->field27_0x36 = 1;
-
-		g_config.addAdditionalAppId(appId);
+		return;
 	}
 
-	//Doing that might be not worth it since this will most likely be easier to mantain
-	//TODO: Backtrace those 4 calls and only patch the really necessary ones since this might be prone to breakage
-	if (g_config.disableFamilyLock && appIdOwnerOverride.count(appId) && appIdOwnerOverride.at(appId) < 4)
-	{
-		pOwnershipInfo->ownerSteamId = 1; //Setting to "arbitrary" steam Id instead of own, otherwise bypass won't work for own games
-		//Unnessecarry again, but whatever
-		pOwnershipInfo->permanent = true;
-		pOwnershipInfo->familyShared = false;
-
-		appIdOwnerOverride[appId]++;
-	}
+	Recorder::CEvent event {};
+	event.hook = hook;
+	event.flags = flags;
+	event.appId = appId;
+	event.dlcId = dlcId;
+	event.arg = arg;
+	event.state = state;
+	event.steamId = g_currentSteamId;
+	event.original = original;
+	event.decision = decision;
+	Recorder::record(event);
+}
 
-	//Returning false after we modify data shouldn't cause any problems because it should just get discarded
+//What Policy asked Steam for during the current CheckAppOwnership call, for the recording
+static thread_local uint32_t queriedAppType;
 
+static bool getAppType(uint32_t appId, EAppType& type)
+{
 	if (!g_pClientApps)
-		return ret;
+		return false;
 
-	auto type = g_pClientApps->getAppType(appId);
-	if (type == APPTYPE_DLC) //Don't touch DLC here, otherwise downloads might break. Hopefully this won't decrease compatibility
-	{
-		return ret;
-	}
+	type = g_pClientApps->getAppType(appId);
+	queriedAppType = type;
+	return true;
+}
 
-	if (g_config.automaticFilter)
-	{
-		switch(type)
-		{
-			case APPTYPE_APPLICATION:
-			case APPTYPE_GAME:
-				break;
+__attribute__((hot))
+static bool hkCheckAppOwnership(void* a0, uint32_t appId, CAppOwnershipInfo* pOwnershipInfo)
+{
+	HookStats::CCallScope stats(Hooks::CheckAppOwnership.statsId);
+	Probes::CHook probe(Hooks::CheckAppOwnership.name.c_str(), appId);
+	const bool ret = Hooks::CheckAppOwnership.callOriginal(a0, appId, pOwnershipInfo);
+	probe.setOriginal(ret);
 
-			default:
-				return ret;
-		}
-	}
+	//Do not log pOwnershipInfo because it gets deleted very quickly, so it's pretty much useless in the logs
+	g_pLog->once("CheckAppOwnership(%p, %u) -> %i\n", a0, appId, ret);
 
-	return true;
+	const uint8_t flags = (pOwnershipInfo ? Recorder::FLAG_OWNERSHIP_INFO : 0) | (pOwnershipInfo && pOwnershipInfo->purchased ? Recorder::FLAG_PURCHASED : 0);
+	queriedAppType = Recorder::STATE_NONE;
+
+	const bool decision = Policy::checkAppOwnership(appId, ret, pOwnershipInfo, g_currentSteamId, getAppType);
+	record(Recorder::HookId::CheckAppOwnership, appId, 0, ret, decision, 0, queriedAppType, flags);
+	return probe.decide(decision);
 }
 
 static void* hkClientAppManager_LaunchApp(void* pClientAppManager, uint32_t* pAppId, void* a2, void* a3, void* a4)
 {
+	HookStats::CCallScope stats(Hooks::IClientAppManager_LaunchApp.statsId);
+	SLS_PROBE(launch_app, pAppId ? *pAppId : 0);
+
 	if (pAppId)
 	{
 		g_pLog->once("IClientAppManager::LaunchApp(%p, %u, %p, %p, %p)\n", pClientAppManager, *pAppId, a2, a3, a4);
-		appIdOwnerOverride[*pAppId] = 0;
+		Policy::onLaunchApp(*pAppId);
+		record(Recorder::HookId::LaunchApp, *pAppId, 0, 0, 0);
 	}
 
 	//Do not do anything in post! Otherwise App launching will break
-	return Hooks::IClientAppManager_LaunchApp.originalFn.fn(pClientAppManager, pAppId, a2, a3, a4);
+	return Hooks::IClientAppManager_LaunchApp.callOriginal(pClientAppManager, pAppId, a2, a3, a4);
 }
 
 static bool hkClientAppManager_IsAppDlcInstalled(void* pClientAppManager, uint32_t appId, uint32_t dlcId)
 {
-	const bool ret = Hooks::IClientAppManager_IsAppDlcInstalled.originalFn.fn(pClientAppManager, appId, dlcId);
+	HookStats::CCallScope stats(Hooks::IClientAppManager_IsAppDlcInstalled.statsId);
+	Probes::CHook probe(Hooks::IClientAppManager_IsAppDlcInstalled.name.c_str(), appId, dlcId);
+	const bool ret = Hooks::IClientAppManager_IsAppDlcInstalled.callOriginal(pClientAppManager, appId, dlcId);
+	probe.setOriginal(ret);
 	g_pLog->once("IClientAppManager::IsAppDlcInstalled(%p, %u, %u) -> %i\n", pClientAppManager, appId, dlcId, ret);
 
-	//Do not pretend things are installed while downloading Apps, otherwise downloads will break for some of them
-	auto state = g_pClientAppManager->getAppInstallState(appId);
-	if (state & APPSTATE_DOWNLOADING || state & APPSTATE_INSTALLING)
-	{
-		g_pLog->once("Skipping DlcId %u because AppId %u has AppState %i\n", dlcId, appId, state);
-		return ret;
-	}
-
-	if (g_config.shouldExcludeAppId(dlcId))
-	{
-		return ret;
-	}
-
-	return true;
+	const EAppState state = reinterpret_cast<IClientAppManager*>(pClientAppManager)->getAppInstallState(appId);
+	const bool decision = Policy::isAppDlcInstalled(appId, dlcId, ret, state);
+	record(Recorder::HookId::IsAppDlcInstalled, appId, dlcId, ret, decision, 0, state);
+	return probe.decide(decision);
 }
 
 static bool hkClientAppManager_BIsDlcEnabled(void* pClientAppManager, uint32_t appId, uint32_t dlcId, void* a3)
 {
-	const bool ret = Hooks::IClientAppManager_BIsDlcEnabled.originalFn.fn(pClientAppManager, appId, dlcId, a3);
+	HookStats::CCallScope stats(Hooks::IClientAppManager_BIsDlcEnabled.statsId);
+	Probes::CHook probe(Hooks::IClientAppManager_BIsDlcEnabled.name.c_str(), appId, dlcId);
+	const bool ret = Hooks::IClientAppManager_BIsDlcEnabled.callOriginal(pClientAppManager, appId, dlcId, a3);
+	probe.setOriginal(ret);
 	g_pLog->once("IClientAppManager::BIsDlcEnabled(%p, %u, %u, %p) -> %i\n", pClientAppManager, appId, dlcId, a3, ret);
 
-	//TODO: Add check for legit ownership to allow toggle on/off
-	if (g_config.shouldExcludeAppId(dlcId))
-	{
-		return ret;
-	}
-
-	return true;
+	const bool decision = Policy::isDlcEnabled(dlcId, ret);
+	record(Recorder::HookId::BIsDlcEnabled, appId, dlcId, ret, decision);
+	return probe.decide(decision);
 }
 
-__attribute__((hot))
-static void hkClientAppManager_PipeLoop(void* pClientAppManager, void* a1, void* a2, void* a3)
+//Found through RTTI in Hooks::setup, otherwise the PipeLoops pick them up from the first interface they see
+static lm_address_t clientAppManagerVTable = LM_ADDRESS_BAD;
+static lm_address_t clientAppsVTable = LM_ADDRESS_BAD;
+
+static void hookClientAppManager(lm_address_t* vtable)
 {
-	g_pClientAppManager = reinterpret_cast<IClientAppManager*>(pClientAppManager);
+	if (Hooks::IClientAppManager_BIsDlcEnabled.hooked)
+	{
+		if (Hooks::IClientAppManager_BIsDlcEnabled.vft->vtable == vtable)
+		{
+			return;
+		}
+
+		g_pLog->debug("IClientAppManager uses vft %p instead of %p, moving hooks\n", vtable, Hooks::IClientAppManager_BIsDlcEnabled.vft->vtable);
+		Hooks::IClientAppManager_BIsDlcEnabled.remove();
+		Hooks::IClientAppManager_LaunchApp.remove();
+		Hooks::IClientAppManager_IsAppDlcInstalled.remove();
+	}
 
-	std::shared_ptr<lm_vmt_t> vft = std::make_shared<lm_vmt_t>();
-	LM_VmtNew(*reinterpret_cast<lm_address_t**>(pClientAppManager), vft.get());
+	std::shared_ptr<lm_vmt_t> vft = std::allocate_shared<lm_vmt_t>(Memory::CAllocator<lm_vmt_t, Memory::Subsystem::Hooks>());
+	LM_VmtNew(vtable, vft.get());
 
 	Hooks::IClientAppManager_BIsDlcEnabled.setup(vft, VFTIndexes::IClientAppManager::BIsDlcEnabled, hkClientAppManager_BIsDlcEnabled);
 	Hooks::IClientAppManager_LaunchApp.setup(vft, VFTIndexes::IClientAppManager::LaunchApp, hkClientAppManager_LaunchApp);
@@ -281,32 +397,40 @@ static void hkClientAppManager_PipeLoop(void* pClientAppManager, void* a1, void*
 	Hooks::IClientAppManager_IsAppDlcInstalled.place();
 
 	g_pLog->debug("IClientAppManager->vft at %p\n", vft->vtable);
+}
+
+__attribute__((hot))
+static void hkClientAppManager_PipeLoop(void* pClientAppManager, void* a1, void* a2, void* a3)
+{
+	hookClientAppManager(*reinterpret_cast<lm_address_t**>(pClientAppManager));
 
+	//Through the trampoline, in case the jmp could not be removed while other threads run
 	Hooks::IClientAppManager_PipeLoop.remove();
-	Hooks::IClientAppManager_PipeLoop.originalFn.fn(pClientAppManager, a1, a2, a3);
+	Hooks::IClientAppManager_PipeLoop.callOriginal(pClientAppManager, a1, a2, a3);
 }
 
 static unsigned int hkClientApps_GetDLCCount(void* pClientApps, uint32_t appId)
 {
-	unsigned int count = Hooks::IClientApps_GetDLCCount.originalFn.fn(pClientApps, appId);
-	if (g_config.dlcData.contains(appId))
-	{
-		count = g_config.dlcData[appId].dlcIds.size();
-	}
+	HookStats::CCallScope stats(Hooks::IClientApps_GetDLCCount.statsId);
+	Probes::CHook probe(Hooks::IClientApps_GetDLCCount.name.c_str(), appId);
+	const unsigned int original = Hooks::IClientApps_GetDLCCount.callOriginal(pClientApps, appId);
+	probe.setOriginal(original);
+	const unsigned int count = Policy::getDlcCount(appId, original);
 
 	g_pLog->once("IClientApps::GetDLCCount(%p, %u) -> %u\n", pClientApps, appId, count);
-	return count;
+	record(Recorder::HookId::GetDLCCount, appId, 0, original, count);
+	return probe.decide(count);
 }
 
 static bool hkClientApps_GetDLCDataByIndex(void* pClientApps, uint32_t appId, int dlcIndex, uint32_t* pDlcId, bool* pIsAvailable, char* pChDlcName, size_t dlcNameLen)
 {
+	HookStats::CCallScope stats(Hooks::IClientApps_GetDLCDataByIndex.statsId);
+	Probes::CHook probe(Hooks::IClientApps_GetDLCDataByIndex.name.c_str(), appId);
 	bool ret;
 
-	if (g_config.dlcData.contains(appId))
+	const auto dlc = g_config.getDlcByIndex(appId, dlcIndex);
+	if (dlc)
 	{
-		auto& data = g_config.dlcData[appId];
-		auto dlc = std::next(data.dlcIds.begin(), dlcIndex);
-
 		*pDlcId = dlc->first;
 
 		//No clue if we have to check for errors during printf since the devs hopefully didn't fuck
@@ -317,26 +441,46 @@ static bool hkClientApps_GetDLCDataByIndex(void* pClientApps, uint32_t appId, in
 	}
 	else
 	{
-		ret = Hooks::IClientApps_GetDLCDataByIndex.originalFn.fn(pClientApps, appId, dlcIndex, pDlcId, pIsAvailable, pChDlcName, dlcNameLen);
+		ret = Hooks::IClientApps_GetDLCDataByIndex.callOriginal(pClientApps, appId, dlcIndex, pDlcId, pIsAvailable, pChDlcName, dlcNameLen);
 	}
 
 	g_pLog->once("IClientApps::GetDLCDataByIndex(%p, %u, %i, %p, %p, %s, %i) -> %i\n", pClientApps, appId, dlcIndex, pDlcId, pIsAvailable, pChDlcName, dlcNameLen, ret);
 
-	if (pIsAvailable && pDlcId && !g_config.shouldExcludeAppId(*pDlcId))
+	//Probe original/decision is whether the dlc is available before and after us, not ret
+	if (pDlcId)
+	{
+		probe.setDlcId(*pDlcId);
+	}
+	const bool original = pIsAvailable && *pIsAvailable;
+	probe.setOriginal(original);
+
+	if (pIsAvailable && pDlcId)
 	{
-		*pIsAvailable = true;
+		*pIsAvailable = Policy::isDlcAvailable(*pDlcId, *pIsAvailable);
 	}
 
+	const bool available = pIsAvailable && *pIsAvailable;
+	record(Recorder::HookId::GetDLCDataByIndex, appId, pDlcId ? *pDlcId : 0, original, available, dlcIndex);
+	probe.decide(available);
 	return ret;
 }
 
-__attribute__((hot))
-static void hkClientApps_PipeLoop(void* pClientApps, void* a1, void* a2, void* a3)
+static void hookClientApps(lm_address_t* vtable)
 {
-	g_pClientApps = reinterpret_cast<IClientApps*>(pClientApps);
+	if (Hooks::IClientApps_GetDLCCount.hooked)
+	{
+		if (Hooks::IClientApps_GetDLCCount.vft->vtable == vtable)
+		{
+			return;
+		}
 
-	std::shared_ptr<lm_vmt_t> vft = std::make_shared<lm_vmt_t>();
-	LM_VmtNew(*reinterpret_cast<lm_address_t**>(pClientApps), vft.get());
+		g_pLog->debug("IClientApps uses vft %p instead of %p, moving hooks\n", vtable, Hooks::IClientApps_GetDLCCount.vft->vtable);
+		Hooks::IClientApps_GetDLCDataByIndex.remove();
+		Hooks::IClientApps_GetDLCCount.remove();
+	}
+
+	std::shared_ptr<lm_vmt_t> vft = std::allocate_shared<lm_vmt_t>(Memory::CAllocator<lm_vmt_t, Memory::Subsystem::Hooks>());
+	LM_VmtNew(vtable, vft.get());
 
 	Hooks::IClientApps_GetDLCDataByIndex.setup(vft, VFTIndexes::IClientApps::GetDLCDataByIndex, hkClientApps_GetDLCDataByIndex);
 	Hooks::IClientApps_GetDLCCount.setup(vft, VFTIndexes::IClientApps::GetDLCCount, hkClientApps_GetDLCCount);
@@ -345,85 +489,119 @@ static void hkClientApps_PipeLoop(void* pClientApps, void* a1, void* a2, void* a
 	Hooks::IClientApps_GetDLCCount.place();
 
 	g_pLog->debug("IClientApps->vft at %p\n", vft->vtable);
-
-	Hooks::IClientApps_PipeLoop.remove();
-	Hooks::IClientApps_PipeLoop.originalFn.fn(pClientApps, a1, a2, a3);
 }
 
-static bool hkClientUser_BIsSubscribedApp(void* pClientUser, uint32_t appId)
+//Still placed with a vtable from RTTI, since CheckAppOwnership needs the IClientApps instance
+__attribute__((hot))
+static void hkClientApps_PipeLoop(void* pClientApps, void* a1, void* a2, void* a3)
 {
-	const bool ret = Hooks::IClientUser_BIsSubscribedApp.tramp.fn(pClientUser, appId);
+	g_pClientApps = reinterpret_cast<IClientApps*>(pClientApps);
+	hookClientApps(*reinterpret_cast<lm_address_t**>(pClientApps));
 
-	g_pLog->once("IClientUser::BIsSubscribedApp(%p, %u) -> %i\n", pClientUser, appId, ret);
+	Hooks::IClientApps_PipeLoop.remove();
+	Hooks::IClientApps_PipeLoop.callOriginal(pClientApps, a1, a2, a3);
+}
 
-	if (g_config.shouldExcludeAppId(appId))
+static bool vtablesHooked = false;
+
+///Summary:
+///Runs once right after ld.so relocated steamclient.so. Hooking vtables any earlier
+///would get our pointers overwritten by their relocations
+static void hkSteamClientInit(int argc, char** argv, char** envp)
+{
+	if (clientAppManagerVTable != LM_ADDRESS_BAD)
 	{
-		return ret;
+		hookClientAppManager(reinterpret_cast<lm_address_t*>(clientAppManagerVTable));
 	}
+	if (clientAppsVTable != LM_ADDRESS_BAD)
+	{
+		hookClientApps(reinterpret_cast<lm_address_t*>(clientAppsVTable));
+	}
+	vtablesHooked = true;
 
-	return true;
+	//ld.so runs initializers on a single thread, so nothing else can be inside _init right now
+	Hooks::SteamClientInit.remove(false);
+	Hooks::SteamClientInit.callOriginal(argc, argv, envp);
 }
 
-static uint32_t hkClientUser_GetSubscribedApps(void* pClientUser, uint32_t* pAppList, size_t size, bool a3)
+static bool hkClientUser_BIsSubscribedApp(void* pClientUser, uint32_t appId)
 {
-	uint32_t count = Hooks::IClientUser_GetSubscribedApps.tramp.fn(pClientUser, pAppList, size, a3);
-	g_pLog->once("IClientUser::GetSubscribedApps(%p, %p, %i, %i) -> %i\n", pClientUser, pAppList, size, a3, count);
+	HookStats::CCallScope stats(Hooks::IClientUser_BIsSubscribedApp.statsId);
+	Probes::CHook probe(Hooks::IClientUser_BIsSubscribedApp.name.c_str(), appId);
+	const bool ret = Hooks::IClientUser_BIsSubscribedApp.callOriginal(pClientUser, appId);
+	probe.setOriginal(ret);
 
-	//Valve calls this function twice, once with size of 0 then again
-	if (!size || !pAppList)
-		return count + g_config.addedAppIds.size();
+	g_pLog->once("IClientUser::BIsSubscribedApp(%p, %u) -> %i\n", pClientUser, appId, ret);
 
-	//TODO: Maybe Add check if AppId already in list before blindly appending
-	for(auto& appId : g_config.addedAppIds)
-	{
-		pAppList[count++] = appId;
-	}
+	const bool decision = Policy::isSubscribedApp(appId, ret);
+	record(Recorder::HookId::BIsSubscribedApp, appId, 0, ret, decision);
+	return probe.decide(decision);
+}
 
-	applistRequested = true;
+static uint32_t hkClientUser_GetSubscribedApps(void* pClientUser, uint32_t* pAppList, size_t size, bool a3)
+{
+	HookStats::CCallScope stats(Hooks::IClientUser_GetSubscribedApps.statsId);
+	Probes::CHook probe(Hooks::IClientUser_GetSubscribedApps.name.c_str(), 0);
+	const uint32_t count = Hooks::IClientUser_GetSubscribedApps.callOriginal(pClientUser, pAppList, size, a3);
+	probe.setOriginal(count);
+	g_pLog->once("IClientUser::GetSubscribedApps(%p, %p, %i, %i) -> %i\n", pClientUser, pAppList, size, a3, count);
 
-	return count;
+	const uint32_t decision = Policy::getSubscribedApps(pAppList, size, count);
+	record(Recorder::HookId::GetSubscribedApps, 0, 0, count, decision, size, Recorder::STATE_NONE, pAppList ? Recorder::FLAG_APP_LIST : 0);
+	return probe.decide(decision);
 }
 
-static void patchRetn(lm_address_t address)
+//Original code of everything we patch without a DetourHook, so it can be restored on its own
+class CPatchState
 {
-	constexpr lm_byte_t retn = 0xC3;
+public:
+	bool applied; //Set when queued, whoever commits has to reset it if that fails
+	lm_address_t address;
+	lm_byte_t original[X86::JMP_REL32_SIZE];
+	size_t size;
+};
+
+static void queuePatch(CPatchTransaction& transaction, CPatchState& state, lm_address_t address, const lm_byte_t* bytes, size_t size)
+{
+	state.address = address;
+	state.size = size;
+	memcpy(state.original, reinterpret_cast<const void*>(address), size);
 
-	lm_prot_t oldProt;
-	LM_ProtMemory(address, 1, LM_PROT_XRW, &oldProt); //LM_PROT_W Should be enough, but just in case something tries to execute it inbetween us setting the prot and writing to it
-	LM_WriteMemory(address, &retn, 1);
-	LM_ProtMemory(address, 1, oldProt, LM_NULL);
+	transaction.write(address, bytes, size);
+	state.applied = true;
 }
 
-static lm_address_t hkGetSteamId;
-static bool createAndPlaceSteamIdHook()
+static void queueRestore(CPatchTransaction& transaction, CPatchState& state)
 {
-	hkGetSteamId = LM_AllocMemory(0, LM_PROT_XRW);
-	if (hkGetSteamId == LM_ADDRESS_BAD)
-	{
-		g_pLog->debug("Failed to allocate memory for GetSteamId!\n");
-		return false;
-	}
+	transaction.write(state.address, state.original, state.size);
+	state.applied = false;
+}
 
-	g_pLog->debug("Allocated memory for GetSteamId hook at %p\n", hkGetSteamId);
+static lm_address_t hkGetSteamId = LM_ADDRESS_BAD;
+static bool createSteamIdHook(CPatchTransaction& transaction, CPatchState& state)
+{
+	Timing::CScope timing("steamIdStub");
 
-	auto insts = std::vector<lm_inst_t>();
+	//Address and size of every instruction up to and including the ret
+	auto insts = std::vector<std::pair<lm_address_t, size_t>>();
 	lm_address_t readAddr = Hooks::IClientUser_GetSteamId;
 	for(;;)
 	{
-		lm_inst_t inst;
-		if (!LM_Disassemble(readAddr, &inst))
+		const size_t size = X86::getInstLength(reinterpret_cast<const lm_byte_t*>(readAddr));
+		if (!size)
 		{
-			g_pLog->debug("Failed to disassemble function at %p!\n", readAddr);
+			g_pLog->debug("Failed to decode instruction at %p!\n", readAddr);
 			return false;
 		}
 
-		insts.emplace_back(inst);
-		readAddr = inst.address + inst.size;
+		insts.emplace_back(readAddr, size);
 
-		if (strcmp(inst.mnemonic, "ret") == 0)
+		if (X86::isRet(reinterpret_cast<const lm_byte_t*>(readAddr)))
 		{
 			break;
 		}
+
+		readAddr += size;
 	}
 
 	const unsigned int retIdx = insts.size() - 1;
@@ -434,52 +612,61 @@ static bool createAndPlaceSteamIdHook()
 	unsigned int instsToOverwrite = 0;
 	for(int i = retIdx; i >= 0; i--)
 	{
-		lm_inst_t inst = insts.at(i);
-		totalBytes += inst.size;
+		totalBytes += insts.at(i).second;
 		instsToOverwrite++;
 
 		//Need only 5 bytes to place relative jmp
-		if (totalBytes >= 5)
+		if (totalBytes >= X86::JMP_REL32_SIZE)
 		{
 			break;
 		}
 	}
 
-	lm_address_t writeAddr = hkGetSteamId;
+	//Called about as often as CheckAppOwnership, so it goes with the hot trampolines
+	hkGetSteamId = g_codeArena.alloc(X86::MOV_MEM_REG_SIZE + totalBytes, true);
+	if (hkGetSteamId == LM_ADDRESS_BAD)
+	{
+		g_pLog->debug("Failed to allocate memory for GetSteamId!\n");
+		return false;
+	}
+
+	g_pLog->debug("Allocated memory for GetSteamId hook at %p\n", hkGetSteamId);
+
+	lm_byte_t* writeAddr = reinterpret_cast<lm_byte_t*>(hkGetSteamId);
 	//TODO: Dynamically resolve register which holds SteamId
-	MemHlp::assembleCodeAt(writeAddr, "mov [%p], ecx", &g_currentSteamId);
+	writeAddr += X86::encodeMovMemReg(writeAddr, reinterpret_cast<lm_address_t>(&g_currentSteamId), X86::ECX);
 
 	//Write the overwritten instructions after our hook code
 	for (unsigned int i = 0; i < instsToOverwrite; i++)
 	{
-		lm_inst_t inst = insts.at(insts.size() - instsToOverwrite + i);
-		memcpy(reinterpret_cast<void*>(writeAddr), inst.bytes, inst.size);
+		auto& inst = insts.at(insts.size() - instsToOverwrite + i);
+		memcpy(writeAddr, reinterpret_cast<const void*>(inst.first), inst.second);
 
-		writeAddr += inst.size;
-		g_pLog->debug("Copied %s %s to tramp\n", inst.mnemonic, inst.op_str);
+		writeAddr += inst.second;
+		g_pLog->debug("Copied %u bytes from %p to tramp\n", inst.second, inst.first);
 	}
 
-	lm_address_t jmpAddr = insts.at(insts.size() - instsToOverwrite).address;
+	PerfMap::add(hkGetSteamId, writeAddr - reinterpret_cast<lm_byte_t*>(hkGetSteamId), "SLSsteam::stub::IClientUser::GetSteamId");
+
+	lm_address_t jmpAddr = insts.at(insts.size() - instsToOverwrite).first;
 	g_pLog->debug("Placing jmp at %p\n", jmpAddr);
 
-	//Might be worth to convert to LM_AssembleEx, but whatever
-	lm_prot_t oldProt;
-	LM_ProtMemory(jmpAddr, 5, LM_PROT_XRW, &oldProt);
-	*reinterpret_cast<lm_byte_t*>(jmpAddr) = 0xE9;
-	*reinterpret_cast<lm_address_t*>(jmpAddr + 1) = hkGetSteamId - jmpAddr - 5;
-	LM_ProtMemory(jmpAddr, 5, oldProt, nullptr);
+	lm_byte_t jmp[X86::JMP_REL32_SIZE];
+	X86::encodeJmp(jmp, jmpAddr, hkGetSteamId);
+	queuePatch(transaction, state, jmpAddr, jmp, sizeof(jmp));
 
 	return true;
 }
 
 namespace Hooks
 {
-	DetourHook<LogSteamPipeCall_t> LogSteamPipeCall("LogSteamPipeCall");
-	DetourHook<CheckAppOwnership_t> CheckAppOwnership("CheckAppOwnership");
-	DetourHook<IClientAppManager_PipeLoop_t> IClientAppManager_PipeLoop("IClientAppManager::PipeLoop");
-	DetourHook<IClientApps_PipeLoop_t> IClientApps_PipeLoop("IClientApps::PipeLoop");
-	DetourHook<IClientUser_BIsSubscribedApp_t> IClientUser_BIsSubscribedApp("IClientUser::BIsSubscribedApp");
-	DetourHook<IClientUser_GetSubscribedApps_t> IClientUser_GetSubscribedApps("IClientUser::GetSubscribedApps");
+	DetourHook<LogSteamPipeCall_t> LogSteamPipeCall("LogSteamPipeCall", &hkLogSteamPipeCall);
+	DetourHook<CheckAppOwnership_t> CheckAppOwnership("CheckAppOwnership", &hkCheckAppOwnership);
+	DetourHook<IClientAppManager_PipeLoop_t> IClientAppManager_PipeLoop("IClientAppManager::PipeLoop", &hkClientAppManager_PipeLoop);
+	DetourHook<IClientApps_PipeLoop_t> IClientApps_PipeLoop("IClientApps::PipeLoop", &hkClientApps_PipeLoop);
+	DetourHook<IClientUser_BIsSubscribedApp_t> IClientUser_BIsSubscribedApp("IClientUser::BIsSubscribedApp", &hkClientUser_BIsSubscribedApp);
+	DetourHook<IClientUser_GetSubscribedApps_t> IClientUser_GetSubscribedApps("IClientUser::GetSubscribedApps", &hkClientUser_GetSubscribedApps);
+	DetourHook<SteamClientInit_t> SteamClientInit("SteamClientInit", &hkSteamClientInit);
 
 	VFTHook<IClientAppManager_BIsDlcEnabled_t> IClientAppManager_BIsDlcEnabled("IClientAppManager::BIsDlcEnabled");
 	VFTHook<IClientAppManager_LaunchApp_t> IClientAppManager_LaunchApp("IClientAppManager::LaunchApp");
@@ -488,28 +675,209 @@ namespace Hooks
 	VFTHook<IClientApps_GetDLCCount_t> IClientApps_GetDLCCount("IClientApps::GetDLCCount");
 
 	lm_address_t IClientUser_GetSteamId;
+	lm_address_t RunningApp;
+	lm_address_t StopPlayingBorrowedApp;
+}
+
+enum class PatchType
+{
+	Detour,
+	Retn, //Makes the function return immediately
+	SteamIdStub
+};
+
+//Features which need a hook. Evaluated again on every config reload
+static bool needsPipeCalls()
+{
+	return g_config.extendedLogging || PipeProfiler::isEnabled() || Tracer::isTracing();
+}
+
+static bool needsFamilyLockPatches()
+{
+	return g_config.disableFamilyLock;
+}
+
+//Bootstrap hooks for the VFT hooks, they never come back once they ran
+static bool needsClientAppManagerPipeLoop()
+{
+	return clientAppManagerVTable == LM_ADDRESS_BAD && !Hooks::IClientAppManager_BIsDlcEnabled.hooked;
+}
+
+static bool needsSteamClientInit()
+{
+	return (clientAppManagerVTable != LM_ADDRESS_BAD || clientAppsVTable != LM_ADDRESS_BAD) && !vtablesHooked;
+}
+
+class CHookEntry
+{
+public:
+	const Patterns::CSite* site;
+	PatchType type;
+	bool hot; //Runs on most Steam IPC calls, keep its code close together
+	bool(*isNeeded)(); //nullptr for always. Only these get attached and detached on config reloads
+	IDetourHook* detour; //For Detour
+	lm_address_t* address; //For everything else
+};
+
+//No pattern, resolved by resolveVTables
+static constexpr Patterns::CSite steamClientInitSite { "SteamClientInit", nullptr, MemHlp::SigFollowMode::None };
+
+//Everything we resolve and patch in steamclient.so, patterns and how to follow them come from Patterns::sites
+static const CHookEntry hookTable[] =
+{
+	{ Patterns::find("IClientUser::GetSteamId"), PatchType::SteamIdStub, true, nullptr, nullptr, &Hooks::IClientUser_GetSteamId },
+	{ Patterns::find("RunningApp"), PatchType::Retn, false, &needsFamilyLockPatches, nullptr, &Hooks::RunningApp },
+	{ Patterns::find("StopPlayingBorrowedApp"), PatchType::Retn, false, &needsFamilyLockPatches, nullptr, &Hooks::StopPlayingBorrowedApp },
+
+	{ Patterns::find("CheckAppOwnership"), PatchType::Detour, true, nullptr, &Hooks::CheckAppOwnership, nullptr },
+	{ Patterns::find("LogSteamPipeCall"), PatchType::Detour, true, &needsPipeCalls, &Hooks::LogSteamPipeCall, nullptr },
+	//PipeLoops remove themselves once they found their interface
+	{ Patterns::find("IClientApps::PipeLoop"), PatchType::Detour, false, nullptr, &Hooks::IClientApps_PipeLoop, nullptr },
+	{ Patterns::find("IClientAppManager::PipeLoop"), PatchType::Detour, false, &needsClientAppManagerPipeLoop, &Hooks::IClientAppManager_PipeLoop, nullptr },
+	{ Patterns::find("IClientUser::BIsSubscribedApp"), PatchType::Detour, true, nullptr, &Hooks::IClientUser_BIsSubscribedApp, nullptr },
+	{ Patterns::find("IClientUser::GetSubscribedApps"), PatchType::Detour, false, nullptr, &Hooks::IClientUser_GetSubscribedApps, nullptr },
+	{ &steamClientInitSite, PatchType::Detour, false, &needsSteamClientInit, &Hooks::SteamClientInit, nullptr }
+};
+
+constexpr size_t HOOK_COUNT = std::size(hookTable);
+static CPatchState patchStates[HOOK_COUNT];
+
+//Serializes config reloads against Hooks::remove
+static std::mutex hooksMutex;
+static bool hooksPlaced = false;
+
+static bool isApplied(size_t i)
+{
+	const CHookEntry& entry = hookTable[i];
+	return entry.detour ? entry.detour->placed : patchStates[i].applied;
+}
+
+static void setApplied(size_t i, bool applied)
+{
+	const CHookEntry& entry = hookTable[i];
+	if (entry.detour)
+	{
+		entry.detour->placed = applied;
+	}
+	else
+	{
+		patchStates[i].applied = applied;
+	}
+}
+
+///Summary:
+///Queues attaching or detaching hookTable[i]
+static bool queueEntry(CPatchTransaction& transaction, size_t i, bool attach)
+{
+	constexpr lm_byte_t retn = 0xC3;
+
+	const CHookEntry& entry = hookTable[i];
+	if (!attach)
+	{
+		if (entry.detour)
+		{
+			entry.detour->queueRemove(transaction);
+		}
+		else
+		{
+			queueRestore(transaction, patchStates[i]);
+		}
+		return true;
+	}
+
+	switch(entry.type)
+	{
+		case PatchType::Detour:
+			return entry.detour->queuePlace(transaction);
+
+		case PatchType::Retn:
+			queuePatch(transaction, patchStates[i], *entry.address, &retn, 1);
+			return true;
+
+		case PatchType::SteamIdStub:
+			return createSteamIdHook(transaction, patchStates[i]);
+	}
+
+	return false;
+}
+
+static void freeGeneratedCode()
+{
+	for(auto& entry : hookTable)
+	{
+		if (entry.detour)
+		{
+			entry.detour->resetTrampoline();
+		}
+	}
+
+	for(auto& state : patchStates)
+	{
+		state.applied = false;
+	}
+
+	hkGetSteamId = LM_ADDRESS_BAD;
+	g_codeArena.release();
+}
+
+///Summary:
+///Looks up the vtables of the interfaces we VFT hook, so they can be hooked before their first call.
+///Whatever can not be found falls back to the PipeLoops
+static void resolveVTables()
+{
+	Timing::CScope timing("rtti");
+
+	if (!RTTI::load(g_modSteamClient))
+	{
+		return;
+	}
+
+	clientAppManagerVTable = RTTI::findVTable("IClientAppManager");
+	clientAppsVTable = RTTI::findVTable("IClientApps");
+	RTTI::clear();
+
+	if (clientAppManagerVTable == LM_ADDRESS_BAD && clientAppsVTable == LM_ADDRESS_BAD)
+	{
+		return;
+	}
+
+	if (!Hooks::SteamClientInit.setup(MemHlp::getInitFunction(g_modSteamClient), false))
+	{
+		clientAppManagerVTable = LM_ADDRESS_BAD;
+		clientAppsVTable = LM_ADDRESS_BAD;
+	}
 }
 
 bool Hooks::setup()
 {
 	g_pLog->debug("Hooks::setup()\n");
 
-	IClientUser_GetSteamId = MemHlp::searchSignature("IClientUser::GetSteamId", Patterns::GetSteamId, g_modSteamClient, MemHlp::SigFollowMode::Relative);
+	g_sigCache.load(g_modSteamClient);
+	MemHlp::loadFunctionTable(g_modSteamClient);
 
-	lm_address_t runningApp = MemHlp::searchSignature("RunningApp", Patterns::FamilyGroupRunningApp, g_modSteamClient, MemHlp::SigFollowMode::Relative);
-	lm_address_t stopPlayingBorrowedApp = MemHlp::searchSignature("StopPlayingBorrowedApp", Patterns::StopPlayingBorrowedApp, g_modSteamClient, MemHlp::SigFollowMode::PrologueUpwards);
+	bool succeeded = true;
+	for(auto& entry : hookTable)
+	{
+		if (!entry.site->pattern)
+		{
+			continue;
+		}
 
-	bool succeeded =
-		CheckAppOwnership.setup(Patterns::CheckAppOwnership, MemHlp::SigFollowMode::Relative, &hkCheckAppOwnership)
-		&& LogSteamPipeCall.setup(Patterns::LogSteamPipeCall, MemHlp::SigFollowMode::Relative, &hkLogSteamPipeCall)
-		&& IClientApps_PipeLoop.setup(Patterns::IClientApps_PipeLoop, MemHlp::SigFollowMode::Relative, &hkClientApps_PipeLoop)
-		&& IClientAppManager_PipeLoop.setup(Patterns::IClientAppManager_PipeLoop, MemHlp::SigFollowMode::Relative, &hkClientAppManager_PipeLoop)
-		&& IClientUser_BIsSubscribedApp.setup(Patterns::IsSubscribedApp, MemHlp::SigFollowMode::Relative, &hkClientUser_BIsSubscribedApp)
-		&& IClientUser_GetSubscribedApps.setup(Patterns::GetSubscribedApps, MemHlp::SigFollowMode::Relative, &hkClientUser_GetSubscribedApps)
+		if (entry.detour)
+		{
+			succeeded = entry.detour->setup(entry.site->pattern, entry.site->followMode, entry.hot);
+		}
+		else
+		{
+			*entry.address = MemHlp::searchSignature(entry.site->name, entry.site->pattern, g_modSteamClient, entry.site->followMode);
+			succeeded = *entry.address != LM_ADDRESS_BAD;
+		}
 
-		&& runningApp != LM_ADDRESS_BAD
-		&& stopPlayingBorrowedApp != LM_ADDRESS_BAD
-		&& IClientUser_GetSteamId != LM_ADDRESS_BAD;
+		if (!succeeded)
+		{
+			break;
+		}
+	}
 
 	if (!succeeded)
 	{
@@ -517,49 +885,146 @@ bool Hooks::setup()
 		return false;
 	}
 
-	//TODO: Elegantly move into Hooks::place()
-	if (g_config.disableFamilyLock)
+	//Only save once everything resolved, otherwise we'd cache a partially broken state
+	g_sigCache.save();
+
+	resolveVTables();
+	return true;
+}
+
+bool Hooks::place()
+{
+	Timing::CScope timing("place");
+
+	if (!g_codeArena.init(g_modSteamClient))
+	{
+		g_pLog->warn("Failed to allocate memory for hooks! Aborting...");
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(hooksMutex);
+
+	//steamclient.so is still being loaded, none of its code ran yet
+	CPatchTransaction transaction(false);
+	bool prepared = true;
+	for(size_t i = 0; i < HOOK_COUNT; i++)
 	{
-		patchRetn(runningApp);
-		patchRetn(stopPlayingBorrowedApp);
+		const CHookEntry& entry = hookTable[i];
+		if (entry.isNeeded && !entry.isNeeded())
+		{
+			g_pLog->debug("Skipping %s, no enabled feature needs it\n", entry.site->name);
+			continue;
+		}
+
+		prepared = queueEntry(transaction, i, true);
+		if (!prepared)
+		{
+			g_pLog->debug("Failed to prepare %s!\n", entry.site->name);
+			break;
+		}
 	}
 
-	//Might move this into main()
-	Hooks::place();
+	if (!prepared || !transaction.commit())
+	{
+		g_pLog->warn("Failed to place hooks! Steam was left untouched");
+		freeGeneratedCode();
+		return false;
+	}
+
+	hooksPlaced = true;
 	return true;
 }
 
-void Hooks::place()
+bool Hooks::applyFeatures()
 {
-	//Detours
-	CheckAppOwnership.place();
-	LogSteamPipeCall.place();
-	IClientApps_PipeLoop.place();
-	IClientAppManager_PipeLoop.place();
-	IClientUser_BIsSubscribedApp.place();
-	IClientUser_GetSubscribedApps.place();
+	std::lock_guard<std::mutex> lock(hooksMutex);
+	if (!hooksPlaced)
+	{
+		return false;
+	}
+
+	CPatchTransaction transaction;
+	auto changed = std::vector<size_t>();
+	for(size_t i = 0; i < HOOK_COUNT; i++)
+	{
+		const CHookEntry& entry = hookTable[i];
+		if (!entry.isNeeded)
+			continue;
+
+		const bool needed = entry.isNeeded();
+		if (needed == isApplied(i))
+			continue;
+
+		//Trampolines stay in g_codeArena after detaching, so attaching again only writes the jmp
+		if (!queueEntry(transaction, i, needed))
+		{
+			g_pLog->warn("Failed to prepare %s!", entry.site->name);
+			for(size_t j : changed)
+			{
+				setApplied(j, !isApplied(j));
+			}
+			return false;
+		}
+
+		changed.push_back(i);
+	}
+
+	if (changed.empty())
+	{
+		return true;
+	}
+
+	if (!transaction.commit())
+	{
+		for(size_t i : changed)
+		{
+			setApplied(i, !isApplied(i));
+		}
 
-	createAndPlaceSteamIdHook();
+		g_pLog->warn("Failed to apply config changes to hooks! They need a restart of Steam");
+		return false;
+	}
+
+	for(size_t i : changed)
+	{
+		g_pLog->info("%s %s\n", isApplied(i) ? "Attached" : "Detached", hookTable[i].site->name);
+	}
+	return true;
 }
 
 void Hooks::remove()
 {
-	//Detours
-	CheckAppOwnership.remove();
-	LogSteamPipeCall.remove();
-	IClientApps_PipeLoop.remove();
-	IClientAppManager_PipeLoop.remove();
-	IClientUser_BIsSubscribedApp.remove();
-	IClientUser_GetSubscribedApps.remove();
+	HookStats::dump();
+
+	//Everything still applied in one go. PipeLoops which already removed themselves get skipped
+	{
+		std::lock_guard<std::mutex> lock(hooksMutex);
+		hooksPlaced = false;
+
+		CPatchTransaction transaction;
+		for(size_t i = 0; i < HOOK_COUNT; i++)
+		{
+			if (isApplied(i))
+			{
+				queueEntry(transaction, i, false);
+			}
+		}
+
+		//Steam would crash jumping into the freed arena otherwise
+		if (transaction.commit())
+		{
+			freeGeneratedCode();
+		}
+		else
+		{
+			g_pLog->warn("Failed to remove hooks!");
+		}
+	}
 
 	//VFT Hooks
 	IClientAppManager_BIsDlcEnabled.remove();
 	IClientAppManager_LaunchApp.remove();
 	IClientAppManager_IsAppDlcInstalled.remove();
 	IClientApps_GetDLCDataByIndex.remove();
-	
-	if (hkGetSteamId != LM_ADDRESS_BAD)
-	{
-		LM_FreeMemory(hkGetSteamId, 0);
-	}
+	IClientApps_GetDLCCount.remove();
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "memhlp.hpp"
+#include "x86.hpp"
 
 #include "libmem/libmem.h"
 
@@ -9,6 +10,8 @@
 #include <memory>
 #include <string>
 
+class CPatchTransaction;
+
 template<typename T>
 union FunctionUnion_t
 {
@@ -25,26 +28,69 @@ public:
 	std::string name;
 	FunctionUnion_t<T> originalFn;
 	FunctionUnion_t<T> hookFn;
+	unsigned int statsId; //Id for HookStats, wrap hook functions in a HookStats::CCallScope with it
 
 	Hook(const char* name);
 
 	virtual void place() = 0;
-	virtual void remove() = 0;
+	///Summary:
+	///Returns false if the hook is still in place
+	virtual bool remove() = 0;
+};
+
+///Summary:
+///Type independent part of DetourHook, so Hooks can describe every detour in one table
+class IDetourHook
+{
+public:
+	bool placed; //Also set by queuePlace/queueRemove, whoever commits has to reset it if that fails
+
+	///Summary:
+	///hot hooks get their trampolines packed together in g_codeArena
+	virtual bool setup(const char* pattern, MemHlp::SigFollowMode followMode, bool hot) = 0;
+
+	///Summary:
+	///Creates the trampoline if needed and queues the jmp to our hook
+	virtual bool queuePlace(CPatchTransaction& transaction) = 0;
+	///Summary:
+	///Queues restoring the original code. The trampoline stays around for placing it again
+	virtual void queueRemove(CPatchTransaction& transaction) = 0;
+	///Summary:
+	///Forgets the trampoline, for when g_codeArena gets released
+	virtual void resetTrampoline() = 0;
 };
 
 template<typename T>
-class DetourHook : public Hook<T>
+class DetourHook : public Hook<T>, public IDetourHook
 {
 public:
 	FunctionUnion_t<T> tramp;
-	size_t size;
+	size_t size; //Bytes copied into the trampoline
+	lm_byte_t originalBytes[X86::JMP_REL32_SIZE];
+	bool hot;
 
-	DetourHook(const char* name);
+	DetourHook(const char* name, T hookFn);
 
+	///Summary:
+	///Places or removes only this hook in its own transaction
 	virtual void place();
-	virtual void remove();
-
-	bool setup(const char* pattern, const MemHlp::SigFollowMode followMode, T hookFn);
+	virtual bool remove();
+	///Summary:
+	///live = false may write across 8 byte boundaries, only for when no other thread can run the function
+	bool remove(bool live);
+
+	virtual bool setup(const char* pattern, MemHlp::SigFollowMode followMode, bool hot);
+	///Summary:
+	///For functions found without a pattern
+	bool setup(lm_address_t fn, bool hot);
+	virtual bool queuePlace(CPatchTransaction& transaction);
+	virtual void queueRemove(CPatchTransaction& transaction);
+	virtual void resetTrampoline();
+
+	///Summary:
+	///Calls the trampoline and attributes the time spent in it to the original function in HookStats
+	template<typename ...Args>
+	auto callOriginal(Args... args);
 };
 
 template<typename T>
@@ -58,7 +104,10 @@ public:
 	VFTHook(const char* name);
 
 	virtual void place();
-	virtual void remove();
+	virtual bool remove();
+
+	template<typename ...Args>
+	auto callOriginal(Args... args);
 
 	void setup(std::shared_ptr<lm_vmt_t> vft, unsigned int index, T hookFn);
 };
@@ -71,6 +120,7 @@ namespace Hooks
 	typedef void(*IClientApps_PipeLoop_t)(void*, void*, void*, void*);
 	typedef bool(*IClientUser_BIsSubscribedApp_t)(void*, uint32_t);
 	typedef uint32_t(*IClientUser_GetSubscribedApps_t)(void*, uint32_t*, size_t, bool);
+	typedef void(*SteamClientInit_t)(int, char**, char**);
 
 	extern DetourHook<LogSteamPipeCall_t> LogSteamPipeCall;
 	extern DetourHook<CheckAppOwnership_t> CheckAppOwnership;
@@ -78,6 +128,7 @@ namespace Hooks
 	extern DetourHook<IClientApps_PipeLoop_t> IClientApps_PipeLoop;
 	extern DetourHook<IClientUser_BIsSubscribedApp_t> IClientUser_BIsSubscribedApp;
 	extern DetourHook<IClientUser_GetSubscribedApps_t> IClientUser_GetSubscribedApps;
+	extern DetourHook<SteamClientInit_t> SteamClientInit;
 
 	typedef bool(*IClientAppManager_BIsDlcEnabled_t)(void*, uint32_t, uint32_t, void*);
 	typedef void*(*IClientAppManager_LaunchApp_t)(void*, uint32_t*, void*, void*, void*);
@@ -92,8 +143,20 @@ namespace Hooks
 	extern VFTHook<IClientApps_GetDLCCount_t> IClientApps_GetDLCCount;
 
 	extern lm_address_t IClientUser_GetSteamId;
+	extern lm_address_t RunningApp;
+	extern lm_address_t StopPlayingBorrowedApp;
 
+	///Summary:
+	///Resolves all patterns without modifying any code. Safe to run while other threads use the log
 	bool setup();
-	void place();
+	///Summary:
+	///Applies every detour and patch needed by the enabled features in a single transaction. Returns false without having modified anything on failure
+	bool place();
+	///Summary:
+	///Attaches or detaches every hook depending on a config option after the config changed.
+	///Hooks which are always needed stay untouched
+	bool applyFeatures();
+	///Summary:
+	///Also dumps HookStats one last time
 	void remove();
 }
@@ -0,0 +1,241 @@
+#include "hookstats.hpp"
+
+#include "config.hpp"
+#include "log.hpp"
+#include "memory.hpp"
+#include "statspage.hpp"
+#include "tracer.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <x86intrin.h>
+
+static const char* names[HookStats::MAX_HOOKS];
+static std::atomic<unsigned int> hookCount;
+
+//Grows only. Blocks of exited threads are kept, since Steam's threads mostly live as long as the process
+static std::atomic<HookStats::CThreadStats*> threads;
+static std::atomic<uint64_t> lastDump;
+//Periodic dumps from hooks and the final one from la_objclose may run at the same time
+static std::mutex dumpMutex;
+
+static thread_local HookStats::CThreadStats* threadStats;
+static thread_local HookStats::CCallScope* currentScope;
+static thread_local unsigned int callsSinceDumpCheck;
+
+static HookStats::CThreadStats* getThreadStats()
+{
+	if (!threadStats)
+	{
+		threadStats = new HookStats::CThreadStats();
+		Memory::add(Memory::Subsystem::Profiling, sizeof(HookStats::CThreadStats));
+		threadStats->next = threads.load(std::memory_order_relaxed);
+		while(!threads.compare_exchange_weak(threadStats->next, threadStats, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	return threadStats;
+}
+
+static unsigned int getBucket(uint64_t cycles)
+{
+	const unsigned int bucket = 63 - __builtin_clzll(cycles | 1);
+	return bucket < HookStats::BUCKETS ? bucket : HookStats::BUCKETS - 1;
+}
+
+static uint64_t getSeconds()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return ts.tv_sec;
+}
+
+static void maybeDump()
+{
+	//Don't even look at the clock on every call
+	if (++callsSinceDumpCheck < 1024)
+	{
+		return;
+	}
+	callsSinceDumpCheck = 0;
+
+	const uint64_t now = getSeconds();
+	uint64_t last = lastDump.load(std::memory_order_relaxed);
+	if (!last)
+	{
+		lastDump.compare_exchange_strong(last, now, std::memory_order_relaxed);
+		return;
+	}
+
+	if (now - last < g_config.hookStatsInterval)
+	{
+		return;
+	}
+
+	//Only one thread gets to dump
+	if (lastDump.compare_exchange_strong(last, now, std::memory_order_relaxed))
+	{
+		//Runs inside whichever hook call got here first, so make the hiccup visible
+		Tracer::CScope scope("HookStats dump");
+		HookStats::dump();
+		Memory::report();
+	}
+}
+
+bool HookStats::isEnabled()
+{
+	return g_config.hookStatsInterval > 0;
+}
+
+unsigned int HookStats::registerHook(const char* name)
+{
+	const unsigned int id = hookCount.fetch_add(1, std::memory_order_relaxed);
+	if (id >= MAX_HOOKS)
+	{
+		return INVALID_ID;
+	}
+
+	names[id] = name;
+	return id;
+}
+
+const char* HookStats::getHookName(unsigned int id)
+{
+	return id < getHookCount() ? names[id] : "Unknown";
+}
+
+unsigned int HookStats::getHookCount()
+{
+	const unsigned int count = hookCount.load(std::memory_order_relaxed);
+	return count < MAX_HOOKS ? count : MAX_HOOKS;
+}
+
+///Summary:
+///Upper bound of the bucket containing the given percentile
+static uint64_t getPercentile(const uint64_t* hist, uint64_t total, double percentile)
+{
+	const uint64_t target = static_cast<uint64_t>(total * percentile);
+	uint64_t seen = 0;
+	for(unsigned int i = 0; i < HookStats::BUCKETS; i++)
+	{
+		seen += hist[i];
+		if (seen > target)
+		{
+			return 2ull << i;
+		}
+	}
+
+	return 2ull << (HookStats::BUCKETS - 1);
+}
+
+void HookStats::dump()
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(dumpMutex);
+	for(unsigned int id = 0; id < getHookCount(); id++)
+	{
+		uint64_t calls = 0, originalCycles = 0, ownCycles = 0;
+		uint64_t originalHist[BUCKETS] = {}, ownHist[BUCKETS] = {};
+
+		for(CThreadStats* cur = threads.load(std::memory_order_acquire); cur; cur = cur->next)
+		{
+			const CCounters& counters = cur->hooks[id];
+			calls += counters.calls.load(std::memory_order_relaxed);
+			originalCycles += counters.originalCycles.load(std::memory_order_relaxed);
+			ownCycles += counters.ownCycles.load(std::memory_order_relaxed);
+
+			for(unsigned int i = 0; i < BUCKETS; i++)
+			{
+				originalHist[i] += counters.originalHist[i].load(std::memory_order_relaxed);
+				ownHist[i] += counters.ownHist[i].load(std::memory_order_relaxed);
+			}
+		}
+
+		if (!calls)
+			continue;
+
+		g_pLog->info
+		(
+			"HookStats %s: calls=%llu original avg=%llu p50<%llu p99<%llu cycles, own avg=%llu p50<%llu p99<%llu cycles\n",
+			names[id],
+			calls,
+			originalCycles / calls,
+			getPercentile(originalHist, calls, 0.5),
+			getPercentile(originalHist, calls, 0.99),
+			ownCycles / calls,
+			getPercentile(ownHist, calls, 0.5),
+			getPercentile(ownHist, calls, 0.99)
+		);
+	}
+}
+
+HookStats::CCallScope::CCallScope(unsigned int id)
+{
+	StatsPage::countHookCall(id);
+
+	this->traceName = Tracer::isRecording() && id != INVALID_ID ? names[id] : nullptr;
+	if (this->traceName)
+	{
+		Tracer::begin(this->traceName);
+	}
+
+	if (!isEnabled() || id == INVALID_ID)
+	{
+		this->id = INVALID_ID;
+		return;
+	}
+
+	this->id = id;
+	this->originalCycles = 0;
+	this->parent = currentScope;
+	currentScope = this;
+
+	this->start = __rdtsc();
+}
+
+HookStats::CCallScope::~CCallScope()
+{
+	if (traceName)
+	{
+		Tracer::end(traceName);
+	}
+
+	if (id == INVALID_ID)
+	{
+		return;
+	}
+
+	const uint64_t total = __rdtsc() - start;
+	const uint64_t own = total > originalCycles ? total - originalCycles : 0;
+	currentScope = parent;
+
+	CCounters& counters = getThreadStats()->hooks[id];
+	counters.calls.store(counters.calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	counters.originalCycles.store(counters.originalCycles.load(std::memory_order_relaxed) + originalCycles, std::memory_order_relaxed);
+	counters.ownCycles.store(counters.ownCycles.load(std::memory_order_relaxed) + own, std::memory_order_relaxed);
+
+	std::atomic<uint64_t>& originalBucket = counters.originalHist[getBucket(originalCycles)];
+	originalBucket.store(originalBucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	std::atomic<uint64_t>& ownBucket = counters.ownHist[getBucket(own)];
+	ownBucket.store(ownBucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	maybeDump();
+}
+
+HookStats::COriginalScope::COriginalScope()
+{
+	this->start = currentScope ? __rdtsc() : 0;
+}
+
+HookStats::COriginalScope::~COriginalScope()
+{
+	if (currentScope && start)
+	{
+		currentScope->originalCycles += __rdtsc() - start;
+	}
+}
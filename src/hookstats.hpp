@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+///Summary:
+///Opt-in per hook call counters and log2 histograms of the cycles spent in the original function
+///and in our own code. Every thread counts into its own block, which only gets summed up when dumping
+namespace HookStats
+{
+	constexpr unsigned int MAX_HOOKS = 32;
+	constexpr unsigned int BUCKETS = 32; //Bucket n counts calls taking [2^n, 2^(n+1)) cycles
+	constexpr unsigned int INVALID_ID = ~0u;
+
+	class CCounters
+	{
+	public:
+		//Only ever written by the owning thread, atomic so dumping from another thread is well defined
+		std::atomic<uint64_t> calls;
+		std::atomic<uint64_t> originalCycles;
+		std::atomic<uint64_t> ownCycles;
+		std::atomic<uint64_t> originalHist[BUCKETS];
+		std::atomic<uint64_t> ownHist[BUCKETS];
+	};
+
+	class CThreadStats
+	{
+	public:
+		CCounters hooks[MAX_HOOKS];
+		CThreadStats* next;
+	};
+
+	bool isEnabled();
+
+	unsigned int registerHook(const char* name);
+	const char* getHookName(unsigned int id);
+	unsigned int getHookCount();
+
+	///Summary:
+	///Logs every hook called so far. Safe to call from any thread, dumps never interleave
+	void dump();
+
+	///Summary:
+	///Measures one call of a hook. Time spent inside CallOriginal scopes gets
+	///attributed to the original function instead of our own code
+	class CCallScope
+	{
+		unsigned int id;
+		uint64_t start;
+		uint64_t originalCycles;
+		CCallScope* parent;
+		const char* traceName; //Set while Tracer records this call
+
+		friend class COriginalScope;
+
+	public:
+		CCallScope(unsigned int id);
+		~CCallScope();
+
+		CCallScope(const CCallScope&) = delete;
+		CCallScope& operator=(const CCallScope&) = delete;
+	};
+
+	class COriginalScope
+	{
+		uint64_t start;
+
+	public:
+		COriginalScope();
+		~COriginalScope();
+	};
+}
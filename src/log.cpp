@@ -17,11 +17,31 @@ CLog::~CLog()
 	{
 		ofstream.close();
 	}
+}
+
+void CLog::sendNotification(LogLevel lvl, const char* formatted)
+{
+	std::stringstream notifySS;
 
-	for(auto& msg : msgCache)
+	switch(lvl)
 	{
-		free(msg);
+		//TODO: Fix possible breakage when there's only one " in formatted
+		case LogLevel::NotifyShort:
+			notifySS << "notify-send -t 10000 -u \"normal\" \"SLSsteam\" \"" << formatted << "\"";
+			break;
+		case LogLevel::NotifyLong:
+			notifySS << "notify-send -t 30000 -u \"normal\" \"SLSsteam\" \"" << formatted << "\"";
+			break;
+		case LogLevel::Warn:
+			notifySS << "notify-send -u \"critical\" \"SLSsteam\" \"" << formatted << "\"";
+			break;
+
+		default:
+			return;
 	}
+
+	system(notifySS.str().c_str());
+	debug("system(\"%s\")\n", notifySS.str().c_str());
 }
 
 CLog* CLog::createDefaultLog()
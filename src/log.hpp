@@ -1,13 +1,21 @@
 #pragma once
 
+#include "memory.hpp"
+#include "probes.hpp"
+#include "statspage.hpp"
+
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <openssl/sha.h>
 #include <sstream>
+#include <string>
+#include <string_view>
 #include <unordered_set>
 
 enum class LogLevel : unsigned int
@@ -21,10 +29,30 @@ enum class LogLevel : unsigned int
 	None
 };
 
+//Longest line formatted without allocating
+constexpr size_t LINE_BUFFER_SIZE = 512;
+
 class CLog
 {
+	//Transparent, so once can look up messages without copying them into a std::string first
+	class CMsgHash
+	{
+	public:
+		using is_transparent = void;
+
+		size_t operator()(std::string_view msg) const
+		{
+			return std::hash<std::string_view>()(msg);
+		}
+	};
+
+	typedef std::basic_string<char, std::char_traits<char>, Memory::CAllocator<char, Memory::Subsystem::Log>> CMsg;
+
 	std::ofstream ofstream;
-	std::unordered_set<char*> msgCache;
+	//Grows with every unique message, so it gets dropped whenever it outgrows the Log budget
+	std::unordered_set<CMsg, CMsgHash, std::equal_to<>, Memory::CAllocator<CMsg, Memory::Subsystem::Log>> msgCache;
+	//Recursive because notifications log their own system() call
+	std::recursive_mutex mutex;
 
 	constexpr const char* logLvlToStr(LogLevel& lvl)
 	{
@@ -48,67 +76,72 @@ class CLog
 		}
 	}
 
+	void sendNotification(LogLevel lvl, const char* formatted);
+
 	template<typename ...Args>
 	__attribute__((hot))
 	void __log(LogLevel lvl, const char* msg, Args... args)
 	{
-		size_t size = snprintf(nullptr, 0, msg, args...) + 1; //Allocate one more byte for zero termination
-		char* formatted = reinterpret_cast<char*>(malloc(size));
-		snprintf(formatted, size, msg, args...);
+		//Hooks log on nearly every call, so only lines not fitting on the stack touch the heap
+		char buffer[LINE_BUFFER_SIZE];
+		std::unique_ptr<char[]> longLine;
+		char* formatted = buffer;
+
+		const int len = snprintf(buffer, sizeof(buffer), msg, args...);
+		if (len < 0)
+		{
+			return;
+		}
+		else if (static_cast<size_t>(len) >= sizeof(buffer))
+		{
+			longLine = std::make_unique<char[]>(len + 1); //One more byte for zero termination
+			formatted = longLine.get();
+			snprintf(formatted, len + 1, msg, args...);
+		}
+
+		//Hooks and the pipelined load log from multiple threads
+		std::lock_guard<std::recursive_mutex> lock(mutex);
 
-		bool freeFormatted = true;
 		if (lvl == LogLevel::Once)
 		{
-			//Can't use match functions from unordered_set because it's to unprecise.
-			//We could replace it with our own if we deem it necessary though
-			for(auto& msg : msgCache)
+			const std::string_view view(formatted, len);
+			if (msgCache.contains(view))
 			{
-				if (strcmp(msg, formatted) == 0)
-				{
-					free(formatted);
-					return;
-				}
+				StatsPage::get()->logOnceDropped.fetch_add(1, std::memory_order_relaxed);
+				return;
 			}
 
-			msgCache.emplace(formatted);
-			freeFormatted = false;
+			msgCache.emplace(view);
+			if (Memory::isOverBudget(Memory::Subsystem::Log))
+			{
+				//Swapped instead of cleared, clear() keeps the buckets around
+				decltype(msgCache)().swap(msgCache);
+				msgCache.emplace(view);
+				StatsPage::get()->logOnceEvictions.fetch_add(1, std::memory_order_relaxed);
+			}
 		}
 
-		std::stringstream notifySS;
+		ofstream << "[" << logLvlToStr(lvl) << "] ";
+		ofstream.write(formatted, len);
+		StatsPage::get()->logLines.fetch_add(1, std::memory_order_relaxed);
 
 		switch(lvl)
 		{
-			//TODO: Fix possible breakage when there's only one " in formatted
 			case LogLevel::NotifyShort:
-				notifySS << "notify-send -t 10000 -u \"normal\" \"SLSsteam\" \"" << formatted << "\"";
-				break;
 			case LogLevel::NotifyLong:
-				notifySS << "notify-send -t 30000 -u \"normal\" \"SLSsteam\" \"" << formatted << "\"";
-				break;
 			case LogLevel::Warn:
-				notifySS << "notify-send -u \"critical\" \"SLSsteam\" \"" << formatted << "\"";
+				ofstream << "\n";
+				sendNotification(lvl, formatted);
 				break;
 
 			default:
 				break;
-
-		}
-
-		ofstream << "[" << logLvlToStr(lvl) << "] " << formatted;
-
-		if (notifySS.str().size() > 0)
-		{
-			ofstream << "\n";
-
-			system(notifySS.str().c_str());
-			debug("system(\"%s\")\n", notifySS.str().c_str());
 		}
 
 		ofstream.flush();
-		if (freeFormatted)
-		{
-			free(formatted);
-		}
+		SLS_PROBE(log_flush, static_cast<unsigned int>(lvl), formatted);
+
+		Memory::checkBudgets();
 	}
 
 public:
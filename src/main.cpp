@@ -1,19 +1,31 @@
 #include "config.hpp"
 #include "globals.hpp"
+#include "hashcache.hpp"
 #include "hooks.hpp"
+#include "hookstats.hpp"
 #include "log.hpp"
+#include "memory.hpp"
+#include "perfmap.hpp"
+#include "pipeprofiler.hpp"
+#include "recorder.hpp"
+#include "statspage.hpp"
+#include "timing.hpp"
+#include "tracer.hpp"
 #include "utils.hpp"
 
 #include "libmem/libmem.h"
 
 #include <cstdio>
 #include <cstdlib>
+#include <cerrno>
 #include <cstring>
 #include <filesystem>
+#include <future>
 #include <link.h>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <sys/auxv.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -60,7 +72,7 @@ static bool verifySteamClientHash()
 
 	try
 	{
-		std::string sha256 = Utils::getFileSHA256(path.c_str());
+		std::string sha256 = HashCache::getFileSHA256(path.c_str(), g_config.paranoidHashCheck);
 		g_pLog->info("steamclient.so hash is %s\n", sha256.c_str());
 
 		//TODO: Research if there's a better way to compare const char* to std::string
@@ -94,47 +106,62 @@ static void unload()
 //TODO: Remove when unload() works properly since it should not be needed anymore after that
 static bool setupSuccess = false;
 
-static void setup()
+//Config gets parsed in the background while Steam starts up until it loads steamclient.so
+static std::shared_future<bool> configLoaded;
+
+//Set once steamclient.so got handled, afterwards la_objopen has nothing left to do
+static bool steamClientHandled = false;
+static uintptr_t* steamClientCookie = nullptr;
+
+///Summary:
+///Returns the executable name of the current process without touching /proc,
+///since every process Steam spawns inherits LD_AUDIT and pays for this
+static const char* getProcessName()
 {
-	lm_process_t proc {};
-	if (!LM_GetProcess(&proc))
+	const char* path = reinterpret_cast<const char*>(getauxval(AT_EXECFN));
+	if (!path)
 	{
-		unload();
-		return;
+		return program_invocation_short_name;
 	}
 
-	//Do not do anything in other processes
-	if (strcmp(proc.name, "steam") != 0)
+	const char* name = strrchr(path, '/');
+	return name ? name + 1 : path;
+}
+
+static void setup()
+{
+	Timing::CScope timing("setup");
+
 	{
-		unload();
-		return;
+		Timing::CScope logTiming("log");
+		g_pLog = std::unique_ptr<CLog>(CLog::createDefaultLog());
 	}
 
-	g_pLog = std::unique_ptr<CLog>(CLog::createDefaultLog());
 	if (!g_pLog)
 	{
 		unload();
 		return;
 	}
 
-	g_pLog->debug("SLSsteam loading in %s\n", proc.name);
+	g_pLog->debug("SLSsteam loading in %s\n", getProcessName());
 
 	cleanEnvVar("LD_AUDIT");
 	cleanEnvVar("LD_PRELOAD");
 
-	if(!g_config.init())
-	{
-		unload();
-		return;
-	}
-
 	//Since we can't statically link everything and some distros seem to respect LD_LIBRARY_PATH
 	//more or less than mine does we just force append those
 	//Hopefully this won't mess anything else up
+	//Has to happen before starting any threads, since setenv is not thread safe
 	auto ldLibPath = std::string(getenv("LD_LIBRARY_PATH"));
 	ldLibPath.append("/usr/lib:/usr/lib32");
 	setenv("LD_LIBRARY_PATH", ldLibPath.c_str(), true);
 
+	configLoaded = std::async(std::launch::async, []()
+	{
+		Timing::CScope timing("config");
+		return g_config.init();
+	}).share();
+
 	setupSuccess = true;
 }
 
@@ -145,14 +172,42 @@ static void load()
 		return;
 	}
 
+	const uint64_t start = Timing::now();
+
 	//This should never happen, but better be safe than sorry in case I refactor someday
-	if (!LM_FindModule("steamclient.so", &g_modSteamClient))
+	bool moduleFound;
+	{
+		Timing::CScope timing("findModule");
+		moduleFound = LM_FindModule("steamclient.so", &g_modSteamClient);
+	}
+
+	if (!moduleFound)
+	{
+		unload();
+		return;
+	}
+
+	//Hash while we scan for patterns. Only placing the hooks needs to wait for the verdict,
+	//so SafeMode still prevents us from touching an unknown steamclient.so
+	auto hashVerified = std::async(std::launch::async, []()
+	{
+		//ParanoidHashCheck decides whether we may use the cached hash
+		configLoaded.wait();
+
+		Timing::CScope timing("hash");
+		return verifySteamClientHash();
+	});
+
+	const bool patternsFound = Hooks::setup();
+	const bool hashMatches = hashVerified.get();
+
+	if (!configLoaded.get() || !patternsFound)
 	{
 		unload();
 		return;
 	}
 
-	if (!verifySteamClientHash())
+	if (!hashMatches)
 	{
 		if (g_config.safeMode)
 		{
@@ -166,30 +221,96 @@ static void load()
 		}
 	}
 
-	if (!Hooks::setup())
+	if (g_config.statsPage)
+	{
+		StatsPage::init();
+	}
+	if (g_config.perfMap)
+	{
+		PerfMap::init();
+	}
+	//Detaches LogSteamPipeCall again, unless something else still needs it
+	Tracer::start([]()
+	{
+		Hooks::applyFeatures();
+	});
+	Recorder::start();
+
+	if (!Hooks::place())
 	{
 		unload();
 		return;
 	}
 
+	g_config.watch([]()
+	{
+		Hooks::applyFeatures();
+	});
+
+	Timing::record("load", start, Timing::now());
+	Timing::logSummary();
+	if (g_config.startupTimingJson)
+	{
+		Timing::writeJson(g_config.getDir().append("/startup-timing.json").c_str());
+	}
+
 	g_pLog->notify("Loaded successfully");
 }
 
 unsigned int la_version(unsigned int)
 {
+	const uint64_t start = Timing::now();
+
+	//Returning 0 makes ld.so unload us again, so steamwebhelper, reapers, games and whatever else
+	//inherited LD_AUDIT don't pay for any of the other callbacks
+	if (strcmp(getProcessName(), "steam") != 0)
+	{
+		return 0;
+	}
+
+	Timing::record("processCheck", start, Timing::now());
 	return LAV_CURRENT;
 }
 
-unsigned int la_objopen(struct link_map *map, __attribute__((unused)) Lmid_t lmid, __attribute__((unused)) uintptr_t *cookie)
+unsigned int la_objopen(struct link_map *map, __attribute__((unused)) Lmid_t lmid, uintptr_t *cookie)
 {
-	if (std::string(map->l_name).ends_with("/steamclient.so"))
+	if (steamClientHandled)
+	{
+		return 0;
+	}
+
+	constexpr char steamClient[] = "/steamclient.so";
+	constexpr size_t steamClientLen = sizeof(steamClient) - 1;
+
+	const size_t len = strlen(map->l_name);
+	if (len >= steamClientLen && memcmp(map->l_name + len - steamClientLen, steamClient, steamClientLen) == 0)
 	{
+		steamClientHandled = true;
+		steamClientCookie = cookie;
 		load();
 	}
 
 	return 0;
 }
 
+unsigned int la_objclose(uintptr_t *cookie)
+{
+	//Last chance to see the stats, since Steam never unloads steamclient.so before exiting
+	if (cookie == steamClientCookie)
+	{
+		HookStats::dump();
+		if (PipeProfiler::isEnabled())
+		{
+			PipeProfiler::report();
+		}
+		StatsPage::close();
+		Recorder::stop();
+		Memory::report();
+	}
+
+	return 0;
+}
+
 void la_preinit(__attribute__((unused)) uintptr_t *cookie)
 {
 	setup();
@@ -1,35 +1,196 @@
 #include "memhlp.hpp"
+#include "codearena.hpp"
 #include "log.hpp"
-#include "utils.hpp"
+#include "sigcache.hpp"
+#include "timing.hpp"
+#include "x86.hpp"
 
+#include <cstdint>
+#include <cstring>
+#include <emmintrin.h>
+#include <link.h>
 #include <vector>
 
-lm_address_t MemHlp::searchSignature(const char* name, const char* signature, lm_module_t module, SigFollowMode mode)
+MemHlp::CSignature::CSignature(const char* signature)
 {
-	lm_address_t address = LM_SigScan(signature, module.base, module.size);
-	if (address == LM_ADDRESS_BAD)
+	const char* cur = signature;
+	while(*cur)
 	{
-		g_pLog->debug("Unable to find signature for %s!\n", name);
+		if (*cur == ' ')
+		{
+			cur++;
+			continue;
+		}
+
+		if (*cur == '?')
+		{
+			bytes.emplace_back(0);
+			mask.push_back('?');
+
+			//Skip both ? of ??
+			while(*cur == '?')
+				cur++;
+
+			continue;
+		}
+
+		char* end;
+		bytes.emplace_back(static_cast<lm_byte_t>(strtoul(cur, &end, 16)));
+		mask.push_back('x');
+
+		//Should only happen on malformed signatures, but better not loop forever
+		if (end == cur)
+		{
+			break;
+		}
+
+		cur = end;
+	}
+}
+
+bool MemHlp::CSignature::matches(lm_address_t address) const
+{
+	const lm_byte_t* mem = reinterpret_cast<const lm_byte_t*>(address);
+	for(size_t i = 0; i < bytes.size(); i++)
+	{
+		if (mask[i] == 'x' && mem[i] != bytes[i])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+lm_address_t MemHlp::CSignature::scan(lm_address_t address, lm_size_t size) const
+{
+	if (bytes.empty() || size < bytes.size())
+	{
+		return LM_ADDRESS_BAD;
+	}
+
+	const size_t anchor = mask.find('x');
+	if (anchor == std::string::npos)
+	{
+		return address;
 	}
-	else
+
+	const lm_byte_t* cur = reinterpret_cast<const lm_byte_t*>(address) + anchor;
+	const lm_byte_t* last = reinterpret_cast<const lm_byte_t*>(address) + size - bytes.size() + anchor;
+	while(cur <= last)
 	{
-		switch (mode)
+		cur = reinterpret_cast<const lm_byte_t*>(memchr(cur, bytes[anchor], last - cur + 1));
+		if (!cur)
+		{
+			break;
+		}
+
+		const lm_address_t start = reinterpret_cast<lm_address_t>(cur) - anchor;
+		if (matches(start))
 		{
-			case SigFollowMode::Relative:
-				g_pLog->debug("Resolving relative of %s at %p\n", name, address);
-				address = MemHlp::getJmpTarget(address);
-				break;
+			return start;
+		}
+
+		cur++;
+	}
+
+	return LM_ADDRESS_BAD;
+}
+
+lm_address_t MemHlp::followSignature(const char* name, lm_address_t address, SigFollowMode mode)
+{
+	switch (mode)
+	{
+		case SigFollowMode::Relative:
+			g_pLog->debug("Resolving relative of %s at %p\n", name, address);
+			return MemHlp::getJmpTarget(address);
 
-			case SigFollowMode::PrologueUpwards:
-				g_pLog->debug("Searching function prologue of %s from %p\n", name, address);
-				address = MemHlp::findPrologue(address);
-				break;
+		case SigFollowMode::PrologueUpwards:
+			g_pLog->debug("Searching function prologue of %s from %p\n", name, address);
+			return MemHlp::findPrologue(address);
+
+		default:
+			return address;
+	}
+}
 
-			default:
-				break;
+///Summary:
+///Match in [start, end) closest to hint, so patterns matching more than once keep resolving to the same site
+static lm_address_t findNearest(const MemHlp::CSignature& sig, lm_address_t start, lm_address_t end, lm_address_t hint)
+{
+	lm_address_t nearest = LM_ADDRESS_BAD;
+	for(lm_address_t cur = sig.scan(start, end - start); cur != LM_ADDRESS_BAD; cur = sig.scan(cur + 1, end - cur - 1))
+	{
+		if (cur >= hint)
+		{
+			//Every match after this one is even further away
+			return nearest == LM_ADDRESS_BAD || cur - hint < hint - nearest ? cur : nearest;
 		}
 
-		g_pLog->info("%s at %p\n", name, address);
+		nearest = cur;
+	}
+
+	return nearest;
+}
+
+lm_address_t MemHlp::scanSignature(const char* name, const char* signature, lm_module_t module)
+{
+	//Steam updates usually only shift functions by a bit, so look around where we found it last time
+	//before falling back to scanning everything
+	constexpr lm_size_t windows[] = { 0x10000, 0x100000 };
+	constexpr SigScanResult windowResults[] = { SigScanResult::Near, SigScanResult::Far };
+
+	const lm_address_t hint = g_sigCache.getHint(name, module);
+	if (hint != LM_ADDRESS_BAD)
+	{
+		const CSignature sig(signature);
+		for(unsigned int i = 0; i < LM_ARRLEN(windows); i++)
+		{
+			const lm_address_t start = hint - module.base > windows[i] ? hint - windows[i] : module.base;
+			const lm_address_t end = module.end - hint > windows[i] ? hint + windows[i] : module.end;
+
+			//Also covers the match still being at its old offset
+			const lm_address_t match = findNearest(sig, start, end, hint);
+			if (match != LM_ADDRESS_BAD)
+			{
+				g_pLog->debug("Found %s within %p bytes of %p\n", name, windows[i], hint);
+				g_sigCache.recordResult(name, windowResults[i]);
+				return match;
+			}
+		}
+	}
+
+	const lm_address_t match = LM_SigScan(signature, module.base, module.size);
+	g_sigCache.recordResult(name, match != LM_ADDRESS_BAD ? SigScanResult::Full : SigScanResult::Missing);
+
+	return match;
+}
+
+lm_address_t MemHlp::searchSignature(const char* name, const char* signature, lm_module_t module, SigFollowMode mode)
+{
+	Timing::CScope timing(std::string("scan:").append(name).append("(").append(followModeToStr(mode)).append(")"));
+
+	lm_address_t address = g_sigCache.find(name, signature, module);
+	if (address != LM_ADDRESS_BAD)
+	{
+		g_sigCache.recordResult(name, SigScanResult::Cached);
+		g_pLog->info("%s at %p (cached)\n", name, address);
+		return address;
+	}
+
+	const lm_address_t match = scanSignature(name, signature, module);
+	if (match == LM_ADDRESS_BAD)
+	{
+		g_pLog->debug("Unable to find signature for %s!\n", name);
+		return LM_ADDRESS_BAD;
+	}
+
+	address = followSignature(name, match, mode);
+	g_pLog->info("%s at %p\n", name, address);
+
+	if (address != LM_ADDRESS_BAD)
+	{
+		g_sigCache.store(name, module, match, address);
 	}
 
 	return address;
@@ -42,48 +203,325 @@ lm_address_t MemHlp::searchSignature(const char* name, const char* signature, lm
 
 lm_address_t MemHlp::getJmpTarget(lm_address_t address)
 {
-	lm_inst_t inst;
-	if (!LM_Disassemble(address, &inst)) //Should not happen if we land in a code section
+	const lm_address_t target = X86::getBranchTarget(address);
+	if (target == LM_ADDRESS_BAD)
 	{
-		g_pLog->debug("Failed to disassemble code at %p!");
+		g_pLog->debug("No relative jmp or call at %p!\n", address);
 		return LM_ADDRESS_BAD;
 	}
 
-	g_pLog->debug("Resolved to %s %s\n", inst.mnemonic, inst.op_str);
+	g_pLog->debug("Resolved to %p\n", target);
+	return target;
+}
+
+//Pointer encodings used by .eh_frame_hdr, see the LSB's Exception Frames chapter
+enum : lm_byte_t
+{
+	DW_EH_PE_absptr = 0x00,
+	DW_EH_PE_udata4 = 0x03,
+	DW_EH_PE_sdata4 = 0x0B,
+	DW_EH_PE_pcrel = 0x10,
+	DW_EH_PE_datarel = 0x30
+};
+
+//Sorted (initial_location, fde) table from .eh_frame_hdr of the module passed to loadFunctionTable
+static const int32_t* fnTable = nullptr;
+static uint32_t fnTableCount = 0;
+static lm_address_t fnTableBase = LM_ADDRESS_BAD; //Entries are relative to the start of .eh_frame_hdr
+static lm_address_t fnTableModuleStart = LM_ADDRESS_BAD;
+static lm_address_t fnTableModuleEnd = LM_ADDRESS_BAD;
+
+///Summary:
+///Reads a DWARF encoded pointer as found in .eh_frame_hdr and advances cur past it
+static bool readEncodedPointer(lm_address_t& cur, lm_byte_t encoding, lm_address_t dataRel, lm_address_t& value)
+{
+	const lm_address_t start = cur;
+	switch(encoding & 0x0F)
+	{
+		case DW_EH_PE_absptr:
+			value = *reinterpret_cast<const lm_address_t*>(cur);
+			cur += sizeof(lm_address_t);
+			break;
+		case DW_EH_PE_udata4:
+			value = *reinterpret_cast<const uint32_t*>(cur);
+			cur += 4;
+			break;
+		case DW_EH_PE_sdata4:
+			value = *reinterpret_cast<const int32_t*>(cur);
+			cur += 4;
+			break;
 
-	if (strcmp(inst.mnemonic, "jmp") != 0 && strcmp(inst.mnemonic, "call") != 0)
+		default:
+			return false;
+	}
+
+	switch(encoding & 0x70)
+	{
+		case 0:
+			break;
+		case DW_EH_PE_pcrel:
+			value += start;
+			break;
+		case DW_EH_PE_datarel:
+			value += dataRel;
+			break;
+
+		default:
+			return false;
+	}
+
+	return true;
+}
+
+bool MemHlp::loadFunctionTable(const lm_module_t& module)
+{
+	const auto ehdr = reinterpret_cast<const ElfW(Ehdr)*>(module.base);
+	const auto phdrs = reinterpret_cast<const ElfW(Phdr)*>(module.base + ehdr->e_phoff);
+
+	for(unsigned int i = 0; i < ehdr->e_phnum; i++)
+	{
+		if (phdrs[i].p_type != PT_GNU_EH_FRAME)
+			continue;
+
+		const lm_address_t hdr = module.base + phdrs[i].p_vaddr;
+		const lm_byte_t* header = reinterpret_cast<const lm_byte_t*>(hdr);
+
+		//version, eh_frame_ptr_enc, fde_count_enc, table_enc
+		if (header[0] != 1 || header[3] != (DW_EH_PE_datarel | DW_EH_PE_sdata4))
+		{
+			g_pLog->debug("Unsupported .eh_frame_hdr in %s (version %u, table encoding %x)\n", module.name, header[0], header[3]);
+			return false;
+		}
+
+		lm_address_t cur = hdr + 4;
+		lm_address_t ehFrame, count;
+		if (!readEncodedPointer(cur, header[1], hdr, ehFrame) || !readEncodedPointer(cur, header[2], hdr, count))
+		{
+			g_pLog->debug("Unable to decode .eh_frame_hdr of %s!\n", module.name);
+			return false;
+		}
+
+		fnTable = reinterpret_cast<const int32_t*>(cur);
+		fnTableCount = count;
+		fnTableBase = hdr;
+		fnTableModuleStart = module.base;
+		fnTableModuleEnd = module.end;
+
+		g_pLog->debug("Indexed %u functions of %s from .eh_frame_hdr\n", fnTableCount, module.name);
+		return true;
+	}
+
+	g_pLog->debug("%s has no .eh_frame_hdr!\n", module.name);
+	return false;
+}
+
+lm_address_t MemHlp::findFunctionStart(lm_address_t address)
+{
+	if (!fnTable || address < fnTableModuleStart || address >= fnTableModuleEnd)
+	{
+		return LM_ADDRESS_BAD;
+	}
+
+	//Binary search for the last function starting at or before address
+	uint32_t low = 0, high = fnTableCount;
+	while(low < high)
+	{
+		const uint32_t mid = low + (high - low) / 2;
+		if (fnTableBase + fnTable[mid * 2] <= address)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (!low)
+	{
+		return LM_ADDRESS_BAD;
+	}
+
+	const lm_address_t start = fnTableBase + fnTable[(low - 1) * 2];
+	const lm_address_t fde = fnTableBase + fnTable[(low - 1) * 2 + 1];
+
+	//FDE layout is length, CIE pointer, pc_begin, pc_range. GCC always encodes pc_begin as pcrel sdata4 on x86,
+	//which makes pc_range a plain 4 byte value
+	const uint32_t range = *reinterpret_cast<const uint32_t*>(fde + 12);
+	if (address >= start + range)
+	{
+		//Gap between functions or code without unwind info
 		return LM_ADDRESS_BAD;
+	}
 
-	return std::stoul(inst.op_str, nullptr, 16);
+	return start;
+}
+
+__attribute__((target("sse2")))
+static const lm_byte_t* findLastSSE2(const lm_byte_t* low, const lm_byte_t* high, const lm_byte_t* bytes, size_t size)
+{
+	//Compare the first and last byte of 16 candidates at once and only memcmp the ones where both matched
+	const __m128i first = _mm_set1_epi8(static_cast<char>(bytes[0]));
+	const __m128i last = _mm_set1_epi8(static_cast<char>(bytes[size - 1]));
+
+	const lm_byte_t* cur = high;
+	while(cur - low >= 15)
+	{
+		const lm_byte_t* block = cur - 15;
+		const __m128i eqFirst = _mm_cmpeq_epi8(first, _mm_loadu_si128(reinterpret_cast<const __m128i*>(block)));
+		const __m128i eqLast = _mm_cmpeq_epi8(last, _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + size - 1)));
+		unsigned int mask = _mm_movemask_epi8(_mm_and_si128(eqFirst, eqLast));
+
+		while(mask)
+		{
+			const unsigned int bit = 31 - __builtin_clz(mask);
+			if (memcmp(block + bit, bytes, size) == 0)
+			{
+				return block + bit;
+			}
+
+			mask &= ~(1u << bit);
+		}
+
+		cur -= 16;
+	}
+
+	for(; cur >= low; cur--)
+	{
+		if (memcmp(cur, bytes, size) == 0)
+		{
+			return cur;
+		}
+	}
+
+	return nullptr;
+}
+
+///Summary:
+///Find the highest occurence of bytes starting in [low, high]
+static const lm_byte_t* findLast(const lm_byte_t* low, const lm_byte_t* high, const lm_byte_t* bytes, size_t size)
+{
+	if (__builtin_cpu_supports("sse2"))
+	{
+		return findLastSSE2(low, high, bytes, size);
+	}
+
+	for(const lm_byte_t* cur = high; cur >= low; cur--)
+	{
+		if (memcmp(cur, bytes, size) == 0)
+		{
+			return cur;
+		}
+	}
+
+	return nullptr;
 }
 
 lm_address_t MemHlp::findPrologue(lm_address_t address)
 {
+	const lm_address_t fnStart = findFunctionStart(address);
+	if (fnStart != LM_ADDRESS_BAD)
+	{
+		g_pLog->debug("Function start found at %p via .eh_frame_hdr\n", fnStart);
+		return fnStart;
+	}
+
 	constexpr unsigned int scanSize = 0x1000; 
-	constexpr lm_byte_t bytes[] = { 0x56, 0x57, 0xe5, 0x89, 0x55 }; //Reverse order since we're searching upwards
+	constexpr lm_byte_t bytes[] = { 0x55, 0x89, 0xe5, 0x57, 0x56 }; //push ebp; mov ebp, esp; push edi; push esi
 	constexpr lm_byte_t bytesSize = sizeof(bytes) / sizeof(bytes[0]);
 
-	for(unsigned int i = 0u; i < scanSize; i++)
+	//Same range the old byte by byte loop covered: The prologue has to end at or before address
+	const lm_byte_t* high = reinterpret_cast<const lm_byte_t*>(address - bytesSize + 1);
+	const lm_byte_t* low = high - scanSize + 1;
+
+	const lm_byte_t* prol = findLast(low, high, bytes, bytesSize);
+	if (prol)
+	{
+		g_pLog->debug("Prologue found at %p\n", prol);
+		return reinterpret_cast<lm_address_t>(prol);
+	}
+
+	g_pLog->debug("Unable to find prologue after going up %p bytes!\n", scanSize);
+	return LM_ADDRESS_BAD;
+}
+
+std::string MemHlp::getBuildId(const lm_module_t& module)
+{
+	//Shared objects get mapped with their first PT_LOAD at offset 0, so module.base is also the load bias
+	const auto ehdr = reinterpret_cast<const ElfW(Ehdr)*>(module.base);
+	if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0)
+	{
+		g_pLog->debug("%s has no ELF header at %p!\n", module.name, module.base);
+		return std::string();
+	}
+
+	const auto phdrs = reinterpret_cast<const ElfW(Phdr)*>(module.base + ehdr->e_phoff);
+	for(unsigned int i = 0; i < ehdr->e_phnum; i++)
+	{
+		if (phdrs[i].p_type != PT_NOTE)
+			continue;
+
+		lm_address_t cur = module.base + phdrs[i].p_vaddr;
+		const lm_address_t end = cur + phdrs[i].p_memsz;
+		while(cur + sizeof(ElfW(Nhdr)) <= end)
+		{
+			const auto note = reinterpret_cast<const ElfW(Nhdr)*>(cur);
+			const char* noteName = reinterpret_cast<const char*>(cur + sizeof(ElfW(Nhdr)));
+			const lm_byte_t* desc = reinterpret_cast<const lm_byte_t*>(cur + sizeof(ElfW(Nhdr)) + ((note->n_namesz + 3) & ~3));
+
+			if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 && memcmp(noteName, "GNU", 4) == 0)
+			{
+				std::string buildId;
+				char hex[3];
+				for(unsigned int j = 0; j < note->n_descsz; j++)
+				{
+					snprintf(hex, sizeof(hex), "%02x", desc[j]);
+					buildId.append(hex);
+				}
+
+				return buildId;
+			}
+
+			cur += sizeof(ElfW(Nhdr)) + ((note->n_namesz + 3) & ~3) + ((note->n_descsz + 3) & ~3);
+		}
+	}
+
+	return std::string();
+}
+
+lm_address_t MemHlp::getInitFunction(const lm_module_t& module)
+{
+	const auto ehdr = reinterpret_cast<const ElfW(Ehdr)*>(module.base);
+	const auto phdrs = reinterpret_cast<const ElfW(Phdr)*>(module.base + ehdr->e_phoff);
+
+	//Before ld.so relocated module these are still link time addresses
+	auto toRuntime = [&module](lm_address_t address)
 	{
-		bool found = true;
-		for(unsigned int j = 0u; j < bytesSize; j++)
+		return address < module.size ? module.base + address : address;
+	};
+
+	for(unsigned int i = 0; i < ehdr->e_phnum; i++)
+	{
+		if (phdrs[i].p_type != PT_DYNAMIC)
+			continue;
+
+		lm_address_t initArray = LM_ADDRESS_BAD;
+		for(auto dyn = reinterpret_cast<const ElfW(Dyn)*>(module.base + phdrs[i].p_vaddr); dyn->d_tag != DT_NULL; dyn++)
 		{
-			if (*reinterpret_cast<lm_byte_t*>(address - i - j) != bytes[j])
+			if (dyn->d_tag == DT_INIT)
 			{
-				found = false;
-				break;
+				return toRuntime(dyn->d_un.d_ptr);
+			}
+
+			if (dyn->d_tag == DT_INIT_ARRAY)
+			{
+				initArray = toRuntime(dyn->d_un.d_ptr);
 			}
 		}
 
-		if (found)
+		if (initArray != LM_ADDRESS_BAD)
 		{
-			lm_address_t prol = address - i - bytesSize + 1; //Add 1 byte back since bytesSize would be to big otherwise
-			g_pLog->debug("Prologue found at %p\n", prol);
-			return prol;
+			return toRuntime(*reinterpret_cast<const lm_address_t*>(initArray));
 		}
 	}
 
-	g_pLog->debug("Unable to find prologue after going up %p bytes!\n", scanSize);
+	g_pLog->debug("%s has no init function!\n", module.name);
 	return LM_ADDRESS_BAD;
 }
 
@@ -91,81 +529,105 @@ bool MemHlp::fixPICThunkCall(const char* name, lm_address_t fn, lm_address_t tra
 {
 	g_pLog->debug("Fixing PIC thunks for %s's trampoline\n", name);
 	constexpr unsigned int maxBytes = 0x5; //Minimum bytes needed to detour a function, so our tramp will at least be of this size
-	
-	lm_inst_t inst;
+
 	for(unsigned int curTrampOffset = 0; curTrampOffset <= maxBytes; )
 	{
-		lm_address_t startAddress = tramp + curTrampOffset;
+		const lm_address_t startAddress = tramp + curTrampOffset;
+		const lm_byte_t* code = reinterpret_cast<const lm_byte_t*>(startAddress);
 
-		if (!LM_Disassemble(startAddress, &inst))
+		const size_t size = X86::getInstLength(code);
+		if (!size)
 		{
-			g_pLog->debug("Unable to dissassemble code at %p\n", tramp + curTrampOffset);
+			g_pLog->debug("Unable to decode instruction at %p\n", startAddress);
 			return false;
 		}
-		
-		curTrampOffset += inst.size;
-		g_pLog->debug("%p: %s %s\n", inst.address, inst.mnemonic, inst.op_str);
-		
-		if (strcmp(inst.mnemonic, "call") != 0)
+
+		curTrampOffset += size;
+
+		if (code[0] != 0xE8)
 			continue;
 
 		//Calculate the call address manually with it's original location
-		lm_address_t followAddress = fn + curTrampOffset + *reinterpret_cast<lm_address_t*>(startAddress + 1);
-		bool isIPCThunk = true;
-		char newInstr[sizeof(inst.mnemonic) + sizeof(inst.op_str)];
+		const lm_address_t thunk = fn + curTrampOffset + *reinterpret_cast<const int32_t*>(code + 1);
+		const lm_byte_t* thunkCode = reinterpret_cast<const lm_byte_t*>(thunk);
 
-		for(unsigned int i = 0; i < 2; i++) //Dissassemble next 2 instructions and check if they're an actual IPC thunk call
+		//PIC thunks are just mov reg, [esp]; ret
+		X86::Register reg;
+		if (!X86::isMovRegFromStackTop(thunkCode, reg) || !X86::isRet(thunkCode + 3))
 		{
-			if (!LM_Disassemble(followAddress, &inst))
-			{
-				g_pLog->debug("Unable to dissassemble code at %p\n", followAddress);
-				return false;
-			}
+			g_pLog->debug("Call at %p to %p is not a PIC thunk\n", startAddress, thunk);
+			continue;
+		}
 
-			followAddress += inst.size;
+		//Load the return address the original call would've pushed directly instead.
+		//mov reg, imm32 has the same size as call rel32, so it fits perfectly
+		const lm_address_t retAddress = fn + curTrampOffset;
+		lm_byte_t newInst[X86::MOV_REG_IMM32_SIZE];
+		X86::encodeMovRegImm(newInst, reg, retAddress);
 
-			g_pLog->debug("%p: %s %s\n", inst.address, inst.mnemonic, inst.op_str);
+		//Trampolines are our own writable memory, no need to change protections
+		memcpy(reinterpret_cast<void*>(startAddress), newInst, sizeof(newInst));
+		g_pLog->debug("Replaced PIC thunk call for %s at %p with mov r%u, %p\n", name, startAddress, reg, retAddress);
+		return true;
+	}
 
-			//Can not declare in switch statement
-			auto splits = std::vector<std::string>();
-			lm_address_t retAddress = LM_ADDRESS_BAD;
-			switch(i)
-			{
-				case 0:
-					if (strcmp(inst.mnemonic, "mov") != 0)
-						isIPCThunk = false;
-					
-					splits = Utils::strsplit(inst.op_str, ","); //Not checking for splits.size() since mov NEEDS a , somewhere
-					retAddress = fn + curTrampOffset; //No need to add any bytes here, since i += inst.size in the outer loop takes care of that
-					sprintf(newInstr, "%s %s, %p", inst.mnemonic, splits.at(0).c_str(), reinterpret_cast<void*>(retAddress));
-					break;
-
-				case 1:
-					if (strcmp(inst.mnemonic, "ret") != 0)
-						isIPCThunk = false;
-					break;
-			}
+	return false;
+}
 
-			if (!isIPCThunk)
-				break;
+lm_address_t MemHlp::createTrampoline(const char* name, lm_address_t fn, bool hot, size_t& stolenSize)
+{
+	stolenSize = 0;
+	while(stolenSize < X86::JMP_REL32_SIZE)
+	{
+		const lm_byte_t* code = reinterpret_cast<const lm_byte_t*>(fn + stolenSize);
+		const size_t size = X86::getInstLength(code);
+		if (!size)
+		{
+			g_pLog->debug("Unable to decode instruction at %p for %s's trampoline\n", fn + stolenSize, name);
+			return LM_ADDRESS_BAD;
 		}
 
-		if (!isIPCThunk)
-			continue;
+		//Short branches can't reach their target from the trampoline
+		const bool isShortBranch = (code[0] >= 0x70 && code[0] <= 0x7F) || (code[0] >= 0xE0 && code[0] <= 0xE3) || code[0] == 0xEB;
+		const bool isNearJcc = code[0] == 0x0F && code[1] >= 0x80 && code[1] <= 0x8F;
+		if (isShortBranch || isNearJcc)
+		{
+			g_pLog->debug("Unable to relocate branch at %p for %s's trampoline\n", fn + stolenSize, name);
+			return LM_ADDRESS_BAD;
+		}
+
+		stolenSize += size;
+	}
+
+	const lm_address_t tramp = g_codeArena.alloc(stolenSize + X86::JMP_REL32_SIZE, hot);
+	if (tramp == LM_ADDRESS_BAD)
+	{
+		g_pLog->debug("Unable to allocate trampoline for %s!\n", name);
+		return LM_ADDRESS_BAD;
+	}
 
-		if(!LM_Assemble(newInstr, &inst))
+	memcpy(reinterpret_cast<void*>(tramp), reinterpret_cast<const void*>(fn), stolenSize);
+	X86::encodeJmp(reinterpret_cast<lm_byte_t*>(tramp + stolenSize), tramp + stolenSize, fn + stolenSize);
+
+	//Has to run before relocating calls, since it resolves them relative to fn
+	fixPICThunkCall(name, fn, tramp);
+
+	for(size_t offset = 0; offset < stolenSize; )
+	{
+		lm_byte_t* code = reinterpret_cast<lm_byte_t*>(tramp + offset);
+		const size_t size = X86::getInstLength(code);
+
+		if (code[0] == 0xE8 || code[0] == 0xE9)
 		{
-			printf("Unable to assemble instruction %s!\n", newInstr);
-			return false;
+			const lm_address_t target = X86::getBranchTarget(fn + offset);
+			if (code[0] == 0xE8)
+				X86::encodeCall(code, tramp + offset, target);
+			else
+				X86::encodeJmp(code, tramp + offset, target);
 		}
 
-		lm_prot_t oldProt;
-		LM_ProtMemory(startAddress, inst.size, LM_PROT_XRW, &oldProt);
-		LM_WriteMemory(startAddress, inst.bytes, inst.size);
-		LM_ProtMemory(startAddress, inst.size, oldProt, nullptr);
-		g_pLog->debug("Replaced PIC thunk call for %s at %p with %s\n", name, followAddress, newInstr);
-		return true;
+		offset += size;
 	}
 
-	return false;
+	return tramp;
 }
@@ -4,6 +4,8 @@
 #include "log.hpp"
 #include <cstdio>
 #include <cstdlib>
+#include <string>
+#include <vector>
 
 namespace MemHlp
 {
@@ -14,41 +16,70 @@ namespace MemHlp
 		PrologueUpwards
 	};
 
-	///Summary:
-	///Write assembly code to address and increase address by bytes written
-	template<typename ...Args>
-	bool assembleCodeAt(lm_address_t& address, const char* fmt, Args... args)
+	constexpr const char* followModeToStr(SigFollowMode mode)
 	{
-		size_t size = snprintf(nullptr, 0, fmt, args...) + 1;
-		char* code = reinterpret_cast<char*>(malloc(size));
-		snprintf(code, size, fmt, args...);
-
-		//TODO: Potentially replace with LM_AssembleEx and only allocate memory as needed
-		static lm_inst_t inst;
-		if (!LM_Assemble(code, &inst))
-		{
-			g_pLog->debug("Failed to assemble %s!\n", code);
-			return false;
-		}
-		if (address != LM_ADDRESS_BAD && !LM_WriteMemory(address, inst.bytes, inst.size))
+		switch(mode)
 		{
-			g_pLog->debug("Failed to write %s to %p!\n", code, address);
-			return false;
-		}
+			case SigFollowMode::None:
+				return "None";
+			case SigFollowMode::Relative:
+				return "Relative";
+			case SigFollowMode::PrologueUpwards:
+				return "PrologueUpwards";
 
-		g_pLog->debug("Wrote %s to %p with %i bytes\n", code, address, inst.size);
-		address += inst.size;
-		return true;
+			default:
+				return "Unknown";
+		}
 	}
 
+	///Summary:
+	///Parsed form of an IDA style signature like "E8 ? ? ? ? 83 C4 10"
+	class CSignature
+	{
+	public:
+		std::vector<lm_byte_t> bytes;
+		std::string mask; //x for exact bytes and ? for wildcards, same format LM_PatternScan expects
+
+		CSignature(const char* signature);
+
+		bool matches(lm_address_t address) const;
+		///Summary:
+		///Alternative to LM_SigScan which skips ahead with memchr to the first non wildcard byte
+		lm_address_t scan(lm_address_t address, lm_size_t size) const;
+	};
+
+	///Summary:
+	///Scan module for signature, starting close to where it was found in the previous steamclient.so build
+	lm_address_t scanSignature(const char* name, const char* signature, lm_module_t module);
+	lm_address_t followSignature(const char* name, lm_address_t address, SigFollowMode mode);
+
 	lm_address_t searchSignature(const char* name, const char* signature, lm_module_t module, SigFollowMode);
 	lm_address_t searchSignature(const char* name, const char* signature, lm_module_t module);
 
 	lm_address_t getJmpTarget(lm_address_t address);
 	lm_address_t findPrologue(lm_address_t address);
 
-	//TODO: Create hooking wrapper that calls this automatically
+	///Summary:
+	///Index function start addresses of module from its .eh_frame_hdr, so findPrologue
+	///can look them up instead of scanning for prologue bytes
+	bool loadFunctionTable(const lm_module_t& module);
+	lm_address_t findFunctionStart(lm_address_t address);
+
+	///Summary:
+	///Returns the GNU build-id of a loaded module as hex string or an empty string if it has none
+	std::string getBuildId(const lm_module_t& module);
+	///Summary:
+	///Returns the function ld.so calls first after relocating module, DT_INIT or the first DT_INIT_ARRAY entry
+	lm_address_t getInitFunction(const lm_module_t& module);
+
 	bool fixPICThunkCall(const char* name, lm_address_t fn, lm_address_t tramp);
+
+	///Summary:
+	///Copies the instructions covering the first JMP_REL32_SIZE bytes of fn into a new trampoline
+	///followed by a jmp back. PIC thunk calls and rel32 branches get fixed up for the new location.
+	///stolenSize receives the amount of bytes copied. Lives in g_codeArena, hot ones get packed together.
+	///Returns LM_ADDRESS_BAD on failure
+	lm_address_t createTrampoline(const char* name, lm_address_t fn, bool hot, size_t& stolenSize);
 	
 	template<typename tFN, typename ...Args>
 	constexpr auto callVFunc(unsigned int index, void* thisPtr, Args... args)
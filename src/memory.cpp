@@ -0,0 +1,96 @@
+#include "memory.hpp"
+
+#include "config.hpp"
+#include "log.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+//Set once a subsystem got warned about, cleared again when it drops below its budget
+static std::atomic<bool> warned[Memory::SUBSYSTEMS];
+
+uint64_t Memory::getUsage(Subsystem tag)
+{
+	return StatsPage::get()->memoryBytes[static_cast<unsigned int>(tag)].load(std::memory_order_relaxed);
+}
+
+uint64_t Memory::getPeak(Subsystem tag)
+{
+	return StatsPage::get()->memoryPeak[static_cast<unsigned int>(tag)].load(std::memory_order_relaxed);
+}
+
+uint64_t Memory::getBudget(Subsystem tag)
+{
+	return static_cast<uint64_t>(g_config.memoryBudgets[static_cast<unsigned int>(tag)].load(std::memory_order_relaxed)) * 1024;
+}
+
+bool Memory::isOverBudget(Subsystem tag)
+{
+	const uint64_t budget = getBudget(tag);
+	return budget && getUsage(tag) > budget;
+}
+
+void Memory::checkBudgets()
+{
+	for(unsigned int i = 0; i < SUBSYSTEMS; i++)
+	{
+		const Subsystem tag = static_cast<Subsystem>(i);
+		if (tag == Subsystem::Log)
+			continue;
+
+		//Runs after every log line, so only write when something changes
+		if (!isOverBudget(tag))
+		{
+			if (warned[i].load(std::memory_order_relaxed))
+				warned[i].store(false, std::memory_order_relaxed);
+			continue;
+		}
+
+		//Set before warning, since warn ends up in here again
+		if (warned[i].exchange(true, std::memory_order_relaxed))
+			continue;
+
+		g_pLog->warn
+		(
+			"SLSsteam's %s memory grew to %llu KiB, more than its MemoryBudgets entry of %llu KiB!",
+			subsystemToStr(tag),
+			static_cast<unsigned long long>(getUsage(tag) / 1024),
+			static_cast<unsigned long long>(getBudget(tag) / 1024)
+		);
+	}
+}
+
+void Memory::report()
+{
+	uint64_t total = 0;
+	for(unsigned int i = 0; i < SUBSYSTEMS; i++)
+	{
+		const Subsystem tag = static_cast<Subsystem>(i);
+		const uint64_t budget = getBudget(tag);
+		total += getUsage(tag);
+
+		if (budget)
+		{
+			g_pLog->info
+			(
+				"Memory %s: %llu bytes, peak %llu, budget %llu\n",
+				subsystemToStr(tag),
+				static_cast<unsigned long long>(getUsage(tag)),
+				static_cast<unsigned long long>(getPeak(tag)),
+				static_cast<unsigned long long>(budget)
+			);
+		}
+		else
+		{
+			g_pLog->info
+			(
+				"Memory %s: %llu bytes, peak %llu\n",
+				subsystemToStr(tag),
+				static_cast<unsigned long long>(getUsage(tag)),
+				static_cast<unsigned long long>(getPeak(tag))
+			);
+		}
+	}
+
+	g_pLog->info("Memory total: %llu bytes\n", static_cast<unsigned long long>(total));
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "statspage.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+///Summary:
+///Bytes SLSsteam itself keeps allocated inside Steam, per subsystem. Containers which can grow over a
+///session count through CAllocator, fixed blocks call add/sub themselves. The counters live in the stats page
+namespace Memory
+{
+	enum class Subsystem : unsigned int
+	{
+		Log,
+		Config,
+		Hooks,
+		Caches,
+		Profiling,
+		Count
+	};
+
+	constexpr unsigned int SUBSYSTEMS = static_cast<unsigned int>(Subsystem::Count);
+	static_assert(SUBSYSTEMS == StatsPage::MEMORY_SUBSYSTEMS, "Stats page has to know about every subsystem");
+
+	constexpr const char* subsystemToStr(Subsystem tag)
+	{
+		switch(tag)
+		{
+			case Subsystem::Log:
+				return "Log";
+			case Subsystem::Config:
+				return "Config";
+			case Subsystem::Hooks:
+				return "Hooks";
+			case Subsystem::Caches:
+				return "Caches";
+			case Subsystem::Profiling:
+				return "Profiling";
+
+			default:
+				return "Unknown";
+		}
+	}
+
+	//Called from allocators, so neither of them may log or allocate themselves
+	inline void add(Subsystem tag, size_t bytes)
+	{
+		const unsigned int i = static_cast<unsigned int>(tag);
+		StatsPage::CLayout* page = StatsPage::get();
+
+		const uint64_t usage = page->memoryBytes[i].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+		uint64_t peak = page->memoryPeak[i].load(std::memory_order_relaxed);
+		while(usage > peak && !page->memoryPeak[i].compare_exchange_weak(peak, usage, std::memory_order_relaxed));
+	}
+
+	inline void sub(Subsystem tag, size_t bytes)
+	{
+		StatsPage::get()->memoryBytes[static_cast<unsigned int>(tag)].fetch_sub(bytes, std::memory_order_relaxed);
+	}
+
+	uint64_t getUsage(Subsystem tag);
+	uint64_t getPeak(Subsystem tag);
+	///Summary:
+	///MemoryBudgets entry of tag in bytes, 0 means unlimited
+	uint64_t getBudget(Subsystem tag);
+	bool isOverBudget(Subsystem tag);
+
+	///Summary:
+	///Warns once for every subsystem which grew past its budget since the last time it was below it.
+	///Log is left out, since it evicts its own cache instead
+	void checkBudgets();
+	///Summary:
+	///Logs usage, peak and budget of every subsystem
+	void report();
+
+	///Summary:
+	///std::allocator which counts everything it hands out towards tag
+	template<typename T, Subsystem tag>
+	class CAllocator
+	{
+	public:
+		typedef T value_type;
+
+		template<typename U>
+		struct rebind
+		{
+			typedef CAllocator<U, tag> other;
+		};
+
+		CAllocator() noexcept = default;
+		template<typename U>
+		CAllocator(const CAllocator<U, tag>&) noexcept {}
+
+		T* allocate(size_t count)
+		{
+			T* ptr = std::allocator<T>().allocate(count);
+			add(tag, count * sizeof(T));
+			return ptr;
+		}
+
+		void deallocate(T* ptr, size_t count) noexcept
+		{
+			sub(tag, count * sizeof(T));
+			std::allocator<T>().deallocate(ptr, count);
+		}
+
+		template<typename U>
+		bool operator==(const CAllocator<U, tag>&) const noexcept
+		{
+			return true;
+		}
+	};
+}
@@ -0,0 +1,213 @@
+#include "patcher.hpp"
+
+#include "log.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+class CPageRun
+{
+public:
+	lm_address_t start;
+	lm_address_t end;
+	int prot; //What to restore afterwards
+};
+
+class CMapping
+{
+public:
+	lm_address_t start;
+	lm_address_t end;
+	int prot;
+};
+
+///Summary:
+///One read of /proc/self/maps instead of one per LM_ProtMemory call
+static std::vector<CMapping> readMappings()
+{
+	std::vector<CMapping> mappings;
+
+	FILE* file = fopen("/proc/self/maps", "r");
+	if (!file)
+	{
+		return mappings;
+	}
+
+	char line[512];
+	while(fgets(line, sizeof(line), file))
+	{
+		unsigned long start, end;
+		char perms[5];
+		if (sscanf(line, "%lx-%lx %4s", &start, &end, perms) != 3)
+			continue;
+
+		int prot = PROT_NONE;
+		if (perms[0] == 'r')
+			prot |= PROT_READ;
+		if (perms[1] == 'w')
+			prot |= PROT_WRITE;
+		if (perms[2] == 'x')
+			prot |= PROT_EXEC;
+
+		mappings.emplace_back(CMapping { static_cast<lm_address_t>(start), static_cast<lm_address_t>(end), prot });
+	}
+
+	fclose(file);
+	return mappings;
+}
+
+static const CMapping* findMapping(const std::vector<CMapping>& mappings, lm_address_t address)
+{
+	for(auto& mapping : mappings)
+	{
+		if (address >= mapping.start && address < mapping.end)
+		{
+			return &mapping;
+		}
+	}
+
+	return nullptr;
+}
+
+static bool fitsBlock(lm_address_t address, size_t size)
+{
+	const lm_address_t block = address & ~static_cast<lm_address_t>(7);
+	return address + size <= block + sizeof(uint64_t);
+}
+
+///Summary:
+///Writes that fit into one aligned 8 byte block get stored at once, so threads running that code
+///never see half a jmp. Everything else is a plain memcpy, commit() only allows those when not live
+static void writeCode(lm_address_t address, const lm_byte_t* bytes, size_t size)
+{
+	const lm_address_t block = address & ~static_cast<lm_address_t>(7);
+	if (!fitsBlock(address, size))
+	{
+		memcpy(reinterpret_cast<void*>(address), bytes, size);
+		return;
+	}
+
+	uint64_t* target = reinterpret_cast<uint64_t*>(block);
+	uint64_t value = __atomic_load_n(target, __ATOMIC_RELAXED);
+	memcpy(reinterpret_cast<lm_byte_t*>(&value) + (address - block), bytes, size);
+	__atomic_store_n(target, value, __ATOMIC_SEQ_CST);
+}
+
+CPatchTransaction::CPatchTransaction(bool live)
+{
+	this->live = live;
+	this->committed = false;
+}
+
+void CPatchTransaction::write(lm_address_t address, const lm_byte_t* bytes, size_t size)
+{
+	writes.emplace_back(CWrite { address, std::vector<lm_byte_t>(bytes, bytes + size) });
+}
+
+bool CPatchTransaction::commit()
+{
+	if (committed)
+	{
+		return true;
+	}
+
+	//Config reloads patch from their own thread. Without this one of them could
+	//restore a page's protection while the other one still writes to it
+	static std::mutex mutex;
+	std::lock_guard<std::mutex> lock(mutex);
+
+	//Another thread could run into the first half of a jmp otherwise
+	if (live)
+	{
+		for(auto& write : writes)
+		{
+			if (!fitsBlock(write.address, write.bytes.size()))
+			{
+				g_pLog->debug("Patch at %p crosses an 8 byte boundary, refusing to write it while Steam runs!\n", write.address);
+				return false;
+			}
+		}
+	}
+
+	const lm_address_t pageSize = sysconf(_SC_PAGESIZE);
+	const std::vector<CMapping> mappings = readMappings();
+
+	//Every page we touch, merged into runs of adjacent pages with the same protection
+	std::vector<CPageRun> pages;
+	for(auto& write : writes)
+	{
+		const lm_address_t first = write.address & ~(pageSize - 1);
+		const lm_address_t last = (write.address + write.bytes.size() - 1) & ~(pageSize - 1);
+
+		for(lm_address_t page = first; page <= last; page += pageSize)
+		{
+			const CMapping* mapping = findMapping(mappings, page);
+			if (!mapping)
+			{
+				g_pLog->debug("Patch at %p targets unmapped memory!\n", write.address);
+				return false;
+			}
+
+			pages.emplace_back(CPageRun { page, page + pageSize, mapping->prot });
+		}
+	}
+
+	std::sort(pages.begin(), pages.end(), [](const CPageRun& a, const CPageRun& b) { return a.start < b.start; });
+
+	std::vector<CPageRun> runs;
+	for(auto& page : pages)
+	{
+		if (!runs.empty() && runs.back().end >= page.start && runs.back().prot == page.prot)
+		{
+			runs.back().end = std::max(runs.back().end, page.end);
+			continue;
+		}
+
+		runs.emplace_back(page);
+	}
+
+	//Make everything writable first, so a failure leaves the code untouched.
+	//Keeping exec on, since other threads might be running code on these pages right now
+	for(size_t i = 0; i < runs.size(); i++)
+	{
+		if (mprotect(reinterpret_cast<void*>(runs[i].start), runs[i].end - runs[i].start, runs[i].prot | PROT_READ | PROT_WRITE | PROT_EXEC) != 0)
+		{
+			g_pLog->debug("Unable to make %p-%p writable!\n", runs[i].start, runs[i].end);
+
+			for(size_t j = 0; j < i; j++)
+			{
+				mprotect(reinterpret_cast<void*>(runs[j].start), runs[j].end - runs[j].start, runs[j].prot);
+			}
+			return false;
+		}
+	}
+
+	for(auto& write : writes)
+	{
+		writeCode(write.address, write.bytes.data(), write.bytes.size());
+	}
+
+	for(auto& write : writes)
+	{
+		char* start = reinterpret_cast<char*>(write.address);
+		__builtin___clear_cache(start, start + write.bytes.size());
+	}
+
+	for(auto& run : runs)
+	{
+		if (mprotect(reinterpret_cast<void*>(run.start), run.end - run.start, run.prot) != 0)
+		{
+			g_pLog->debug("Unable to restore protection of %p-%p!\n", run.start, run.end);
+		}
+	}
+
+	g_pLog->debug("Applied %zu patches with %zu mprotect rounds\n", writes.size(), runs.size());
+	committed = true;
+	return true;
+}
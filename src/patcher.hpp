@@ -0,0 +1,35 @@
+#pragma once
+
+#include "libmem/libmem.h"
+
+#include <cstddef>
+#include <vector>
+
+///Summary:
+///Collects code writes and applies them together. Writes get grouped by page, so every page only gets
+///made writable and restored once, and either all writes get applied or none of them
+class CPatchTransaction
+{
+	class CWrite
+	{
+	public:
+		lm_address_t address;
+		std::vector<lm_byte_t> bytes;
+	};
+
+	std::vector<CWrite> writes;
+	bool live;
+	bool committed;
+
+public:
+	///Summary:
+	///live for code other threads might be running while we patch it. Its writes have to fit into
+	///one aligned 8 byte block, so they can be stored in one go
+	CPatchTransaction(bool live = true);
+
+	void write(lm_address_t address, const lm_byte_t* bytes, size_t size);
+
+	///Summary:
+	///Applies all writes. On failure nothing got changed
+	bool commit();
+};
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "memhlp.hpp"
+
 #include "libmem/libmem.h"
 
+#include <string_view>
+
 namespace Patterns
 {
 	//Relative
@@ -28,5 +32,45 @@ namespace Patterns
 	constexpr lm_string_t IsSubscribedApp = "E8 ? ? ? ? 83 C4 10 84 C0 74 ? 8B 95 ? ? ? ? 83 EC 04";
 	//Relative, not unique. All matches point to correct function though
 	constexpr lm_string_t GetSteamId = "E8 ? ? ? ? 89 D8 83 C4 0C 83 C4 08 5B C2 04 00 ? 83 EC 08 50 53 FF D2 89 D8 83 C4 0C 83 C4 08 5B C2 04 00";
+
+	class CSite
+	{
+	public:
+		const char* name;
+		lm_string_t pattern;
+		MemHlp::SigFollowMode followMode;
+	};
+
+	///Summary:
+	///Every pattern with the name it gets logged as and how to get from its match to the function.
+	///hookTable in hooks.cpp, slsscan, slsbench and mockgen are all built from this
+	inline constexpr CSite sites[] =
+	{
+		{ "LogSteamPipeCall", LogSteamPipeCall, MemHlp::SigFollowMode::Relative },
+		{ "CheckAppOwnership", CheckAppOwnership, MemHlp::SigFollowMode::Relative },
+		{ "RunningApp", FamilyGroupRunningApp, MemHlp::SigFollowMode::Relative },
+		{ "StopPlayingBorrowedApp", StopPlayingBorrowedApp, MemHlp::SigFollowMode::PrologueUpwards },
+		{ "IClientAppManager::PipeLoop", IClientAppManager_PipeLoop, MemHlp::SigFollowMode::Relative },
+		{ "IClientApps::PipeLoop", IClientApps_PipeLoop, MemHlp::SigFollowMode::Relative },
+		{ "IClientUser::PipeLoop", IClientUser_PipeLoop, MemHlp::SigFollowMode::Relative },
+		{ "IClientUser::GetSubscribedApps", GetSubscribedApps, MemHlp::SigFollowMode::Relative },
+		{ "IClientUser::BIsSubscribedApp", IsSubscribedApp, MemHlp::SigFollowMode::Relative },
+		{ "IClientUser::GetSteamId", GetSteamId, MemHlp::SigFollowMode::Relative }
+	};
+
+	///Summary:
+	///Looks up a site by name at compile time, so a typo fails the build
+	consteval const CSite* find(const char* name)
+	{
+		for(auto& site : sites)
+		{
+			if (std::string_view(site.name) == name)
+			{
+				return &site;
+			}
+		}
+
+		throw "Unknown pattern site";
+	}
 }
 
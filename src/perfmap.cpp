@@ -0,0 +1,176 @@
+#include "perfmap.hpp"
+
+#include "config.hpp"
+#include "log.hpp"
+#include "timing.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <elf.h>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+//See tools/perf/Documentation/jitdump-specification.txt in the kernel tree
+namespace JitDump
+{
+	constexpr uint32_t MAGIC = 0x4A695444;
+	constexpr uint32_t VERSION = 1;
+	constexpr uint32_t CODE_LOAD = 0;
+
+	class CHeader
+	{
+	public:
+		uint32_t magic;
+		uint32_t version;
+		uint32_t totalSize;
+		uint32_t elfMach;
+		uint32_t pad1;
+		uint32_t pid;
+		uint64_t timestamp;
+		uint64_t flags;
+	};
+
+	class CCodeLoad
+	{
+	public:
+		uint32_t id;
+		uint32_t totalSize;
+		uint64_t timestamp;
+		uint32_t pid;
+		uint32_t tid;
+		uint64_t vma;
+		uint64_t codeAddr;
+		uint64_t codeSize;
+		uint64_t codeIndex;
+		//Followed by the zero terminated name and the code itself
+	};
+}
+
+static std::mutex mutex;
+static FILE* mapFile = nullptr;
+static int jitFd = -1;
+static uint64_t codeIndex = 0;
+
+static bool openJitDump()
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/jit-%i.dump", getpid());
+
+	jitFd = open(path, O_CREAT | O_TRUNC | O_RDWR | O_CLOEXEC, 0644);
+	if (jitFd < 0)
+	{
+		g_pLog->debug("Unable to create %s!\n", path);
+		return false;
+	}
+
+	//perf record only picks up jitdumps that got mmapped executable, the mapping is just a marker
+	void* marker = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC, MAP_PRIVATE, jitFd, 0);
+	if (marker == MAP_FAILED)
+	{
+		g_pLog->debug("Unable to map %s!\n", path);
+		close(jitFd);
+		jitFd = -1;
+		return false;
+	}
+
+	JitDump::CHeader header {};
+	header.magic = JitDump::MAGIC;
+	header.version = JitDump::VERSION;
+	header.totalSize = sizeof(header);
+	header.elfMach = sizeof(void*) == 4 ? EM_386 : EM_X86_64;
+	header.pid = getpid();
+	header.timestamp = Timing::now(); //perf has to record with -k mono for these to line up
+
+	if (write(jitFd, &header, sizeof(header)) != sizeof(header))
+	{
+		g_pLog->debug("Unable to write jitdump header!\n");
+		close(jitFd);
+		jitFd = -1;
+		return false;
+	}
+
+	g_pLog->info("Writing jitdump to %s\n", path);
+	return true;
+}
+
+bool PerfMap::init()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (mapFile)
+	{
+		return true;
+	}
+
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/perf-%i.map", getpid());
+
+	//Appending, in case something else in Steam writes its own entries
+	mapFile = fopen(path, "a");
+	if (!mapFile)
+	{
+		g_pLog->debug("Unable to open %s!\n", path);
+		return false;
+	}
+
+	g_pLog->info("Writing perf map to %s\n", path);
+
+	if (g_config.perfJitDump)
+	{
+		openJitDump();
+	}
+
+	return true;
+}
+
+bool PerfMap::isEnabled()
+{
+	return mapFile != nullptr;
+}
+
+void PerfMap::add(lm_address_t address, size_t size, const char* name)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!mapFile || address == LM_ADDRESS_BAD || !size)
+	{
+		return;
+	}
+
+	fprintf(mapFile, "%lx %zx %s\n", static_cast<unsigned long>(address), size, name);
+	fflush(mapFile);
+
+	if (jitFd < 0)
+	{
+		return;
+	}
+
+	const size_t nameSize = strlen(name) + 1;
+
+	JitDump::CCodeLoad record {};
+	record.id = JitDump::CODE_LOAD;
+	record.totalSize = sizeof(record) + nameSize + size;
+	record.timestamp = Timing::now();
+	record.pid = getpid();
+	record.tid = syscall(SYS_gettid);
+	record.vma = address;
+	record.codeAddr = address;
+	record.codeSize = size;
+	record.codeIndex = codeIndex++;
+
+	std::string buf;
+	buf.reserve(record.totalSize);
+	buf.append(reinterpret_cast<const char*>(&record), sizeof(record));
+	buf.append(name, nameSize);
+	buf.append(reinterpret_cast<const char*>(address), size);
+
+	if (write(jitFd, buf.data(), buf.size()) != static_cast<ssize_t>(buf.size()))
+	{
+		g_pLog->debug("Unable to write jitdump record for %s!\n", name);
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "libmem/libmem.h"
+
+#include <cstddef>
+
+///Summary:
+///Names the code we generate at runtime for profilers. Writes /tmp/perf-<pid>.map when PerfMap is enabled
+///and additionally jitdump records to /tmp/jit-<pid>.dump for perf inject --jit when PerfJitDump is enabled
+namespace PerfMap
+{
+	bool init();
+	bool isEnabled();
+
+	///Summary:
+	///Registers size bytes at address as name. Call after the code got written, since jitdump copies it
+	void add(lm_address_t address, size_t size, const char* name);
+}
@@ -0,0 +1,227 @@
+#include "pipeprofiler.hpp"
+
+#include "config.hpp"
+#include "log.hpp"
+#include "timing.hpp"
+#include "tracer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <vector>
+
+static PipeProfiler::CEntry table[PipeProfiler::TABLE_SIZE];
+static std::atomic<uint64_t> overflowCalls;
+static std::atomic<uint64_t> lastReport;
+//Guards lastReportTime and reportedCalls. Periodic reports from hooks and the final one
+//from la_objclose may run at the same time
+static std::mutex reportMutex;
+static uint64_t lastReportTime;
+
+static thread_local unsigned int callsSinceReportCheck;
+
+enum : uint32_t
+{
+	EMPTY = 0,
+	CLAIMING,
+	READY
+};
+
+static unsigned int hashPair(const char* iface, const char* fn)
+{
+	uint64_t hash = reinterpret_cast<uintptr_t>(iface) * 0x9E3779B97F4A7C15ull;
+	hash ^= reinterpret_cast<uintptr_t>(fn) + 0x7F4A7C15 + (hash << 6) + (hash >> 2);
+	return static_cast<unsigned int>(hash ^ (hash >> 32)) & (PipeProfiler::TABLE_SIZE - 1);
+}
+
+static PipeProfiler::CEntry* findOrInsert(const char* iface, const char* fn)
+{
+	const unsigned int start = hashPair(iface, fn);
+	for(unsigned int i = 0; i < PipeProfiler::TABLE_SIZE; i++)
+	{
+		PipeProfiler::CEntry& entry = table[(start + i) & (PipeProfiler::TABLE_SIZE - 1)];
+
+		uint32_t state = entry.state.load(std::memory_order_acquire);
+		if (state == EMPTY)
+		{
+			if (entry.state.compare_exchange_strong(state, CLAIMING, std::memory_order_acquire))
+			{
+				entry.iface = iface;
+				entry.fn = fn;
+				entry.minGap.store(UINT64_MAX, std::memory_order_relaxed);
+				entry.state.store(READY, std::memory_order_release);
+				return &entry;
+			}
+		}
+
+		//Somebody else is claiming this slot right now, might be for the same pair
+		while(state == CLAIMING)
+		{
+			state = entry.state.load(std::memory_order_acquire);
+		}
+
+		if (entry.iface == iface && entry.fn == fn)
+		{
+			return &entry;
+		}
+	}
+
+	return nullptr;
+}
+
+static void updateMin(std::atomic<uint64_t>& value, uint64_t candidate)
+{
+	uint64_t cur = value.load(std::memory_order_relaxed);
+	while(candidate < cur && !value.compare_exchange_weak(cur, candidate, std::memory_order_relaxed));
+}
+
+static void updateMax(std::atomic<uint64_t>& value, uint64_t candidate)
+{
+	uint64_t cur = value.load(std::memory_order_relaxed);
+	while(candidate > cur && !value.compare_exchange_weak(cur, candidate, std::memory_order_relaxed));
+}
+
+static uint64_t getSeconds()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return ts.tv_sec;
+}
+
+static void maybeReport()
+{
+	if (++callsSinceReportCheck < 1024)
+	{
+		return;
+	}
+	callsSinceReportCheck = 0;
+
+	const uint64_t now = getSeconds();
+	uint64_t last = lastReport.load(std::memory_order_relaxed);
+	if (!last)
+	{
+		if (lastReport.compare_exchange_strong(last, now, std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock(reportMutex);
+			lastReportTime = Timing::now();
+		}
+		return;
+	}
+
+	if (now - last < g_config.pipeProfileInterval)
+	{
+		return;
+	}
+
+	//Only one thread gets to report
+	if (lastReport.compare_exchange_strong(last, now, std::memory_order_relaxed))
+	{
+		Tracer::CScope scope("PipeProfiler report");
+		PipeProfiler::report();
+	}
+}
+
+bool PipeProfiler::isEnabled()
+{
+	return g_config.pipeProfileInterval > 0;
+}
+
+__attribute__((hot))
+void PipeProfiler::record(const char* iface, const char* fn)
+{
+	CEntry* entry = findOrInsert(iface, fn);
+	if (!entry)
+	{
+		overflowCalls.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	const uint64_t now = Timing::now();
+	const uint64_t prev = entry->lastCall.exchange(now, std::memory_order_relaxed);
+	if (prev)
+	{
+		const uint64_t gap = now > prev ? now - prev : 0;
+		updateMin(entry->minGap, gap);
+		updateMax(entry->maxGap, gap);
+	}
+	else
+	{
+		entry->firstCall.store(now, std::memory_order_relaxed);
+	}
+
+	entry->calls.fetch_add(1, std::memory_order_relaxed);
+
+	maybeReport();
+}
+
+void PipeProfiler::report()
+{
+	std::lock_guard<std::mutex> lock(reportMutex);
+
+	const uint64_t now = Timing::now();
+	const double interval = lastReportTime ? (now - lastReportTime) / 1e9 : 0;
+	lastReportTime = now;
+
+	class CRow
+	{
+	public:
+		CEntry* entry;
+		uint64_t calls;
+		uint64_t delta;
+	};
+
+	std::vector<CRow> rows;
+	uint64_t totalDelta = 0;
+	for(auto& entry : table)
+	{
+		if (entry.state.load(std::memory_order_acquire) != READY)
+			continue;
+
+		const uint64_t calls = entry.calls.load(std::memory_order_relaxed);
+		rows.emplace_back(CRow { &entry, calls, calls - entry.reportedCalls });
+		totalDelta += calls - entry.reportedCalls;
+		entry.reportedCalls = calls;
+	}
+
+	std::sort(rows.begin(), rows.end(), [](const CRow& a, const CRow& b)
+	{
+		return a.delta > b.delta || (a.delta == b.delta && a.calls > b.calls);
+	});
+
+	g_pLog->info
+	(
+		"PipeProfile: %zu distinct calls, %llu since last report, %llu not tracked\n",
+		rows.size(),
+		static_cast<unsigned long long>(totalDelta),
+		static_cast<unsigned long long>(overflowCalls.load(std::memory_order_relaxed))
+	);
+
+	const size_t count = std::min<size_t>(rows.size(), g_config.pipeProfileTop);
+	for(size_t i = 0; i < count; i++)
+	{
+		const CRow& row = rows[i];
+		if (!row.delta)
+			break;
+
+		const CEntry& entry = *row.entry;
+		const uint64_t first = entry.firstCall.load(std::memory_order_relaxed);
+		const uint64_t last = entry.lastCall.load(std::memory_order_relaxed);
+		const uint64_t minGap = entry.minGap.load(std::memory_order_relaxed);
+		const double avgGapMs = row.calls > 1 ? (last - first) / 1e6 / (row.calls - 1) : 0;
+
+		g_pLog->info
+		(
+			"PipeProfile %s::%s: calls=%llu total=%llu rate=%.1f/s gap min=%.3fms avg=%.3fms max=%.3fms\n",
+			entry.iface,
+			entry.fn,
+			static_cast<unsigned long long>(row.delta),
+			static_cast<unsigned long long>(row.calls),
+			interval > 0 ? row.delta / interval : 0,
+			minGap == UINT64_MAX ? 0 : minGap / 1e6,
+			avgGapMs,
+			entry.maxGap.load(std::memory_order_relaxed) / 1e6
+		);
+	}
+}
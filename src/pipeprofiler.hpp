@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+///Summary:
+///Aggregates LogSteamPipeCall into per (iface, fn) counters instead of writing a line per call like
+///ExtendedLogging does. Pairs are interned by pointer into a fixed table, so memory stays bounded and the
+///hot path never allocates or does I/O. Every PipeProfileInterval seconds the busiest calls get logged
+namespace PipeProfiler
+{
+	constexpr unsigned int TABLE_SIZE = 1024; //Power of two, Steam has a few hundred distinct pipe calls
+
+	class CEntry
+	{
+	public:
+		//0 = empty, 1 = being claimed, 2 = ready
+		std::atomic<uint32_t> state;
+		const char* iface;
+		const char* fn;
+
+		std::atomic<uint64_t> calls;
+		std::atomic<uint64_t> firstCall; //Timing::now() of the first and last call
+		std::atomic<uint64_t> lastCall;
+		std::atomic<uint64_t> minGap; //Inter-arrival times in ns
+		std::atomic<uint64_t> maxGap;
+
+		uint64_t reportedCalls; //Only touched while holding the report lock
+	};
+
+	bool isEnabled();
+
+	void record(const char* iface, const char* fn);
+	///Summary:
+	///Logs the busiest calls since the previous report. Safe to call from any thread
+	void report();
+}
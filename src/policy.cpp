@@ -0,0 +1,165 @@
+#include "policy.hpp"
+
+#include "config.hpp"
+#include "log.hpp"
+#include "memory.hpp"
+
+#include <cstdint>
+#include <map>
+
+static bool applistRequested = false;
+static auto appIdOwnerOverride = std::map<uint32_t, int, std::less<uint32_t>, Memory::CAllocator<std::pair<const uint32_t, int>, Memory::Subsystem::Hooks>>();
+
+bool Policy::checkAppOwnership(uint32_t appId, bool original, CAppOwnershipInfo* pOwnershipInfo, uint32_t steamId, GetAppType_t getAppType)
+{
+	//Wait Until GetSubscribedApps gets called once to let Steam request and populate legit data first.
+	//Afterwards modifying should hopefully not affect false positives anymore
+	if (!applistRequested || g_config.shouldExcludeAppId(appId) || !pOwnershipInfo || !steamId)
+	{
+		return original;
+	}
+
+	if (g_config.isAddedAppId(appId) || (g_config.playNotOwnedGames && !pOwnershipInfo->purchased))
+	{
+		//Changing the purchased field is enough, but just for nicety in the Steamclient UI we change the owner too
+		pOwnershipInfo->ownerSteamId = steamId;
+		pOwnershipInfo->purchased = true;
+
+		//Unnessecary but whatever
+		pOwnershipInfo->permanent = true;
+		pOwnershipInfo->familyShared = false;
+
+		//Found in backtrace
+		pOwnershipInfo->releaseState = 4;
+		pOwnershipInfo->field10_0x25 = 0;
+		//Seems to do nothing in particular, some dlc have this as 1 so I uncomented this for now. Might be free stuff?
+		//pOwnershipInfo->field27_0x36 = 1;
+
+		g_config.addAdditionalAppId(appId);
+	}
+
+	//Doing that might be not worth it since this will most likely be easier to mantain
+	//TODO: Backtrace those 4 calls and only patch the really necessary ones since this might be prone to breakage
+	if (g_config.disableFamilyLock && appIdOwnerOverride.count(appId) && appIdOwnerOverride.at(appId) < 4)
+	{
+		pOwnershipInfo->ownerSteamId = 1; //Setting to "arbitrary" steam Id instead of own, otherwise bypass won't work for own games
+		//Unnessecarry again, but whatever
+		pOwnershipInfo->permanent = true;
+		pOwnershipInfo->familyShared = false;
+
+		appIdOwnerOverride[appId]++;
+	}
+
+	//Returning false after we modify data shouldn't cause any problems because it should just get discarded
+
+	EAppType type;
+	if (!getAppType(appId, type))
+		return original;
+
+	if (type == APPTYPE_DLC) //Don't touch DLC here, otherwise downloads might break. Hopefully this won't decrease compatibility
+	{
+		return original;
+	}
+
+	if (g_config.automaticFilter)
+	{
+		switch(type)
+		{
+			case APPTYPE_APPLICATION:
+			case APPTYPE_GAME:
+				break;
+
+			default:
+				return original;
+		}
+	}
+
+	return true;
+}
+
+bool Policy::isSubscribedApp(uint32_t appId, bool original)
+{
+	if (g_config.shouldExcludeAppId(appId))
+	{
+		return original;
+	}
+
+	return true;
+}
+
+uint32_t Policy::getSubscribedApps(uint32_t* pAppList, size_t size, uint32_t count)
+{
+	//Valve calls this function twice, once with size of 0 then again
+	if (!size || !pAppList)
+		return count + g_config.addedAppIds.size();
+
+	//TODO: Maybe Add check if AppId already in list before blindly appending
+	for(auto& appId : g_config.addedAppIds)
+	{
+		pAppList[count++] = appId;
+	}
+
+	applistRequested = true;
+
+	return count;
+}
+
+bool Policy::isAppDlcInstalled(uint32_t appId, uint32_t dlcId, bool original, EAppState state)
+{
+	//Do not pretend things are installed while downloading Apps, otherwise downloads will break for some of them
+	if (state & APPSTATE_DOWNLOADING || state & APPSTATE_INSTALLING)
+	{
+		g_pLog->once("Skipping DlcId %u because AppId %u has AppState %i\n", dlcId, appId, state);
+		return original;
+	}
+
+	if (g_config.shouldExcludeAppId(dlcId))
+	{
+		return original;
+	}
+
+	return true;
+}
+
+bool Policy::isDlcEnabled(uint32_t dlcId, bool original)
+{
+	//TODO: Add check for legit ownership to allow toggle on/off
+	if (g_config.shouldExcludeAppId(dlcId))
+	{
+		return original;
+	}
+
+	return true;
+}
+
+unsigned int Policy::getDlcCount(uint32_t appId, unsigned int original)
+{
+	const auto data = g_config.dlcData.find(appId);
+	if (data != g_config.dlcData.end())
+	{
+		return data->second.dlcIds.size();
+	}
+
+	return original;
+}
+
+bool Policy::isDlcAvailable(uint32_t dlcId, bool original)
+{
+	if (g_config.shouldExcludeAppId(dlcId))
+	{
+		return original;
+	}
+
+	return true;
+}
+
+void Policy::onLaunchApp(uint32_t appId)
+{
+	appIdOwnerOverride[appId] = 0;
+}
+
+void Policy::reset()
+{
+	applistRequested = false;
+	appIdOwnerOverride.clear();
+}
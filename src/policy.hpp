@@ -0,0 +1,34 @@
+#pragma once
+
+#include "sdk/CAppOwnershipInfo.hpp"
+#include "sdk/IClientAppManager.hpp"
+#include "sdk/IClientApps.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+///Summary:
+///Decisions of our ownership and DLC hooks, kept apart from Steam's interfaces so they can be built
+///for the host and replayed against recordings. Whatever Steam gets asked for comes in as arguments
+namespace Policy
+{
+	///Summary:
+	///Returns false when the type can not be looked up yet. Only gets called when the decision
+	///depends on it, since asking Steam is a pipe call of its own
+	typedef bool(*GetAppType_t)(uint32_t appId, EAppType& type);
+
+	bool checkAppOwnership(uint32_t appId, bool original, CAppOwnershipInfo* pOwnershipInfo, uint32_t steamId, GetAppType_t getAppType);
+	bool isSubscribedApp(uint32_t appId, bool original);
+	///Summary:
+	///Appends AdditionalApps to pAppList and returns the new count. Steam asks with size 0 first
+	uint32_t getSubscribedApps(uint32_t* pAppList, size_t size, uint32_t count);
+	bool isAppDlcInstalled(uint32_t appId, uint32_t dlcId, bool original, EAppState state);
+	bool isDlcEnabled(uint32_t dlcId, bool original);
+	unsigned int getDlcCount(uint32_t appId, unsigned int original);
+	bool isDlcAvailable(uint32_t dlcId, bool original);
+	void onLaunchApp(uint32_t appId);
+
+	///Summary:
+	///Forgets what previous calls changed, so a recording can be replayed more than once
+	void reset();
+}
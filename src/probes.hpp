@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+//USDT probes for bpftrace/perf probe. Each one is a single nop until something attaches, e.g.
+//bpftrace -e 'usdt:/path/to/SLSsteam.so:SLSsteam:hook_return { printf("%s %u -> %d\n", str(arg0), arg1, arg4); }'
+//Emits the same .note.stapsdt entries as systemtap's sys/sdt.h, so building doesn't depend on it being installed
+
+#if __SIZEOF_POINTER__ == 8
+	#define SLS_PROBE_ADDR ".8byte"
+#else
+	#define SLS_PROBE_ADDR ".4byte"
+#endif
+
+//Size of the argument, negative for signed ones. %n prints the negated constant
+#define SLS_PROBE_OPERAND(n, x) \
+	[size##n] "n" ((std::is_signed_v<Probes::ArgType<decltype(x)>> ? 1 : -1) * static_cast<int>(sizeof(Probes::ArgType<decltype(x)>))), \
+	[arg##n] "nor" (static_cast<Probes::ArgType<decltype(x)>>(x))
+#define SLS_PROBE_FORMAT(n) "%n[size" #n "]@%[arg" #n "]"
+
+#define SLS_PROBE_ASM(name, format, ...) \
+	__asm__ __volatile__ \
+	( \
+		"990: nop\n" \
+		".pushsection .note.stapsdt, \"?\", \"note\"\n" \
+		".balign 4\n" \
+		".4byte 992f-991f, 994f-993f, 3\n" \
+		"991: .asciz \"stapsdt\"\n" \
+		"992: .balign 4\n" \
+		"993: " SLS_PROBE_ADDR " 990b\n" \
+		SLS_PROBE_ADDR " _.stapsdt.base\n" \
+		SLS_PROBE_ADDR " 0\n" /*No semaphore*/ \
+		".asciz \"SLSsteam\"\n" \
+		".asciz \"" #name "\"\n" \
+		".asciz \"" format "\"\n" \
+		"994: .balign 4\n" \
+		".popsection\n" \
+		/*Tools compute the probe address relative to this, only one may exist per object*/ \
+		".ifndef _.stapsdt.base\n" \
+		".pushsection .stapsdt.base, \"aG\", \"progbits\", .stapsdt.base, comdat\n" \
+		".weak _.stapsdt.base\n" \
+		".hidden _.stapsdt.base\n" \
+		"_.stapsdt.base: .space 1\n" \
+		".size _.stapsdt.base, 1\n" \
+		".popsection\n" \
+		".endif\n" \
+		:: __VA_ARGS__ \
+	)
+
+#define SLS_PROBE_1(name, a1) \
+	SLS_PROBE_ASM(name, SLS_PROBE_FORMAT(1), SLS_PROBE_OPERAND(1, a1))
+#define SLS_PROBE_2(name, a1, a2) \
+	SLS_PROBE_ASM(name, SLS_PROBE_FORMAT(1) " " SLS_PROBE_FORMAT(2), SLS_PROBE_OPERAND(1, a1), SLS_PROBE_OPERAND(2, a2))
+#define SLS_PROBE_3(name, a1, a2, a3) \
+	SLS_PROBE_ASM(name, SLS_PROBE_FORMAT(1) " " SLS_PROBE_FORMAT(2) " " SLS_PROBE_FORMAT(3), SLS_PROBE_OPERAND(1, a1), SLS_PROBE_OPERAND(2, a2), SLS_PROBE_OPERAND(3, a3))
+#define SLS_PROBE_4(name, a1, a2, a3, a4) \
+	SLS_PROBE_ASM(name, SLS_PROBE_FORMAT(1) " " SLS_PROBE_FORMAT(2) " " SLS_PROBE_FORMAT(3) " " SLS_PROBE_FORMAT(4), SLS_PROBE_OPERAND(1, a1), SLS_PROBE_OPERAND(2, a2), SLS_PROBE_OPERAND(3, a3), SLS_PROBE_OPERAND(4, a4))
+#define SLS_PROBE_5(name, a1, a2, a3, a4, a5) \
+	SLS_PROBE_ASM(name, SLS_PROBE_FORMAT(1) " " SLS_PROBE_FORMAT(2) " " SLS_PROBE_FORMAT(3) " " SLS_PROBE_FORMAT(4) " " SLS_PROBE_FORMAT(5), SLS_PROBE_OPERAND(1, a1), SLS_PROBE_OPERAND(2, a2), SLS_PROBE_OPERAND(3, a3), SLS_PROBE_OPERAND(4, a4), SLS_PROBE_OPERAND(5, a5))
+#define SLS_PROBE_PICK(_1, _2, _3, _4, _5, macro, ...) macro
+
+///Summary:
+///Takes 1 to 5 integer or pointer arguments, i386 can't pass more in registers anyway
+#define SLS_PROBE(name, ...) SLS_PROBE_PICK(__VA_ARGS__, SLS_PROBE_5, SLS_PROBE_4, SLS_PROBE_3, SLS_PROBE_2, SLS_PROBE_1)(name, __VA_ARGS__)
+
+namespace Probes
+{
+	///Summary:
+	///What an argument gets passed as, arrays as pointers
+	template<typename T>
+	using ArgType = std::decay_t<T>;
+
+	///Summary:
+	///Fires hook_entry(name, appId, dlcId) on construction and hook_return(name, appId, dlcId, original, decision)
+	///through decide(). Route every return of a hook through decide() so no exit gets missed
+	class CHook
+	{
+		const char* name;
+		uint32_t appId;
+		uint32_t dlcId;
+		intptr_t original; //Register sized, 64 bit USDT arguments are unreliable on i386
+
+	public:
+		CHook(const char* name, uint32_t appId, uint32_t dlcId = 0)
+		{
+			this->name = name;
+			this->appId = appId;
+			this->dlcId = dlcId;
+			this->original = 0;
+
+			SLS_PROBE(hook_entry, this->name, this->appId, this->dlcId);
+		}
+
+		void setOriginal(intptr_t original)
+		{
+			this->original = original;
+		}
+
+		void setDlcId(uint32_t dlcId)
+		{
+			this->dlcId = dlcId;
+		}
+
+		template<typename T>
+		T decide(T decision)
+		{
+			SLS_PROBE(hook_return, this->name, this->appId, this->dlcId, this->original, static_cast<intptr_t>(decision));
+			return decision;
+		}
+	};
+}
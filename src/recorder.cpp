@@ -0,0 +1,110 @@
+#include "recorder.hpp"
+
+#include "config.hpp"
+#include "log.hpp"
+#include "memory.hpp"
+#include "timing.hpp"
+#include "tracer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+static std::atomic<bool> recording;
+static std::mutex mutex;
+static FILE* file;
+static std::unique_ptr<char[]> fileBuffer;
+static uint64_t events;
+static constexpr size_t bufferSize = 1024 * 1024;
+static thread_local uint32_t tid;
+
+bool Recorder::start()
+{
+	if (!g_config.recordDuration)
+	{
+		return false;
+	}
+
+	const std::string path = g_config.getDir().append("/hooks.slsrec");
+	file = fopen(path.c_str(), "w");
+	if (!file)
+	{
+		g_pLog->debug("Unable to write hook recording to %s!\n", path.c_str());
+		return false;
+	}
+
+	//Plenty for a few seconds of hook calls, so they rarely wait for the disk. Passed in ourselves,
+	//glibc ignores the size otherwise and allocates its own during the first hook call
+	fileBuffer = std::make_unique<char[]>(bufferSize);
+	setvbuf(file, fileBuffer.get(), _IOFBF, bufferSize);
+	Memory::add(Memory::Subsystem::Profiling, bufferSize);
+
+	const CHeader header { MAGIC, VERSION, sizeof(CEvent), static_cast<uint32_t>(getpid()), Timing::now() };
+	fwrite(&header, sizeof(header), 1, file);
+
+	recording.store(true, std::memory_order_release);
+	g_pLog->info("Recording hook calls to %s for %u seconds\n", path.c_str(), g_config.recordDuration);
+
+	std::thread([]()
+	{
+		pthread_setname_np(pthread_self(), "SLSsteam record");
+
+		std::this_thread::sleep_for(std::chrono::seconds(g_config.recordDuration));
+
+		//Flushing the rest of the buffer makes hook calls wait for the mutex meanwhile
+		Tracer::CScope scope("Recorder stop");
+		stop();
+	}).detach();
+
+	return true;
+}
+
+void Recorder::stop()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!file)
+	{
+		return;
+	}
+
+	recording.store(false, std::memory_order_relaxed);
+	fclose(file);
+	file = nullptr;
+	fileBuffer.reset();
+	Memory::sub(Memory::Subsystem::Profiling, bufferSize);
+
+	g_pLog->info("Recorded %llu hook calls\n", static_cast<unsigned long long>(events));
+}
+
+bool Recorder::isRecording()
+{
+	return recording.load(std::memory_order_relaxed);
+}
+
+void Recorder::record(CEvent& event)
+{
+	if (!tid)
+	{
+		tid = syscall(SYS_gettid);
+	}
+
+	event.timestamp = Timing::now();
+	event.tid = tid;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	//Checked again, stop() might have closed the file while we waited
+	if (!file)
+	{
+		return;
+	}
+
+	fwrite(&event, sizeof(event), 1, file);
+	events++;
+}
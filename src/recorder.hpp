@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+
+///Summary:
+///Opt-in binary recording of every ownership and DLC hook call, including what Steam returned and what
+///we decided. slsreplay feeds them into the host build of Policy to benchmark it and catch changed decisions
+namespace Recorder
+{
+	constexpr uint32_t MAGIC = 0x52534C53; //SLSR
+	constexpr uint32_t VERSION = 1;
+	//State of events which never asked Steam for an AppType or AppState
+	constexpr uint32_t STATE_NONE = 0xFFFFFFFF;
+
+	enum class HookId : uint8_t
+	{
+		CheckAppOwnership,
+		BIsSubscribedApp,
+		GetSubscribedApps,
+		IsAppDlcInstalled,
+		BIsDlcEnabled,
+		GetDLCCount,
+		GetDLCDataByIndex,
+		LaunchApp,
+		Count
+	};
+
+	enum EventFlags : uint8_t
+	{
+		FLAG_OWNERSHIP_INFO = 1 << 0, //CheckAppOwnership got a CAppOwnershipInfo
+		FLAG_PURCHASED = 1 << 1, //Its purchased field before we touched it
+		FLAG_APP_LIST = 1 << 2 //GetSubscribedApps got a list to fill
+	};
+
+	class CHeader
+	{
+	public:
+		uint32_t magic;
+		uint32_t version;
+		uint32_t eventSize;
+		uint32_t pid;
+		uint64_t start; //Timing::now() when recording started
+	};
+
+	///Summary:
+	///Same layout on i386 and x86_64, so the host can read what Steam wrote
+	class CEvent
+	{
+	public:
+		uint64_t timestamp;
+		uint32_t tid;
+		HookId hook;
+		uint8_t flags;
+		uint16_t reserved;
+		uint32_t appId;
+		uint32_t dlcId;
+		uint32_t arg; //Index for GetDLCDataByIndex, list size for GetSubscribedApps
+		uint32_t state; //AppType for CheckAppOwnership, AppState for IsAppDlcInstalled
+		uint32_t steamId;
+		int32_t original;
+		int32_t decision;
+		uint32_t reserved2;
+	};
+	static_assert(sizeof(CEvent) == 48);
+
+	constexpr const char* hookIdToStr(HookId id)
+	{
+		switch(id)
+		{
+			case HookId::CheckAppOwnership:
+				return "CheckAppOwnership";
+			case HookId::BIsSubscribedApp:
+				return "IClientUser::BIsSubscribedApp";
+			case HookId::GetSubscribedApps:
+				return "IClientUser::GetSubscribedApps";
+			case HookId::IsAppDlcInstalled:
+				return "IClientAppManager::IsAppDlcInstalled";
+			case HookId::BIsDlcEnabled:
+				return "IClientAppManager::BIsDlcEnabled";
+			case HookId::GetDLCCount:
+				return "IClientApps::GetDLCCount";
+			case HookId::GetDLCDataByIndex:
+				return "IClientApps::GetDLCDataByIndex";
+			case HookId::LaunchApp:
+				return "IClientAppManager::LaunchApp";
+
+			default:
+				return "Unknown";
+		}
+	}
+
+	///Summary:
+	///Starts writing hooks.slsrec in the config directory for RecordDuration seconds
+	bool start();
+	void stop();
+	bool isRecording();
+
+	///Summary:
+	///Fills in timestamp and tid, then appends event
+	void record(CEvent& event);
+}
@@ -0,0 +1,424 @@
+#include "rtti.hpp"
+
+#include "log.hpp"
+#include "memory.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <link.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class CRange
+{
+public:
+	lm_address_t start;
+	lm_address_t end;
+
+	bool contains(lm_address_t address) const
+	{
+		return address >= start && address < end;
+	}
+};
+
+//Layouts from the Itanium C++ ABI
+class CTypeInfo
+{
+public:
+	uintptr_t vptr;
+	uintptr_t name;
+};
+
+class CSIClassTypeInfo
+{
+public:
+	uintptr_t vptr;
+	uintptr_t name;
+	uintptr_t base;
+};
+
+class CVMIClassTypeInfo
+{
+public:
+	uintptr_t vptr;
+	uintptr_t name;
+	unsigned int flags;
+	unsigned int baseCount;
+	//Followed by baseCount CBaseClassInfo
+};
+
+class CBaseClassInfo
+{
+public:
+	uintptr_t base;
+	intptr_t offsetFlags; //Offset of the base in the upper bits
+};
+
+constexpr unsigned int VMI_MAX_FLAGS = 3; //non_diamond_repeat_mask | diamond_shaped_mask
+constexpr unsigned int VMI_MAX_BASES = 64;
+constexpr int BASE_OFFSET_SHIFT = 8;
+
+static lm_module_t indexedModule;
+static std::vector<CRange> readOnly; //Where type names live, code last since it only holds them without -z separate-code
+static std::vector<CRange> data; //Everything but code
+static CRange relro;
+//Every word in relro pointing into data or at a type name as {target, location}, sorted by target
+static std::vector<std::pair<lm_address_t, lm_address_t>, Memory::CAllocator<std::pair<lm_address_t, lm_address_t>, Memory::Subsystem::Hooks>> pointers;
+//Values of not yet applied relocations against symbols, since their words still hold only the addend
+static std::unordered_map<lm_address_t, lm_address_t, std::hash<lm_address_t>, std::equal_to<lm_address_t>, Memory::CAllocator<std::pair<const lm_address_t, lm_address_t>, Memory::Subsystem::Hooks>> symbolRelocs;
+
+///Summary:
+///Turns a link time address into a runtime one, so it does not matter whether ld.so relocated the word yet
+static lm_address_t normalize(uintptr_t value)
+{
+	if (value >= indexedModule.base && value < indexedModule.end)
+	{
+		return value;
+	}
+
+	if (value < indexedModule.size)
+	{
+		return indexedModule.base + value;
+	}
+
+	return LM_ADDRESS_BAD;
+}
+
+static uintptr_t readWord(lm_address_t address)
+{
+	uintptr_t value;
+	memcpy(&value, reinterpret_cast<const void*>(address), sizeof(value));
+	return value;
+}
+
+///Summary:
+///Reads a pointer stored at address, whether ld.so relocated it yet or not
+static lm_address_t readPointer(lm_address_t address)
+{
+	const auto reloc = symbolRelocs.find(address);
+	if (reloc != symbolRelocs.end())
+	{
+		return reloc->second;
+	}
+
+	return normalize(readWord(address));
+}
+
+static bool isIn(const std::vector<CRange>& ranges, lm_address_t address)
+{
+	return std::any_of(ranges.begin(), ranges.end(), [address](const CRange& range) { return range.contains(address); });
+}
+
+///Summary:
+///Matches mangled class names like 11IClientApps
+static bool isTypeName(lm_address_t address)
+{
+	if (address == LM_ADDRESS_BAD || !isIn(readOnly, address))
+	{
+		return false;
+	}
+
+	const char* name = reinterpret_cast<const char*>(address);
+	size_t len = 0;
+	size_t i = 0;
+	for(; isdigit(name[i]) && i < 4; i++)
+	{
+		len = len * 10 + (name[i] - '0');
+	}
+
+	if (!i || !len || !isIn(readOnly, address + i + len))
+	{
+		return false;
+	}
+
+	return memchr(name + i, 0, len) == nullptr && name[i + len] == 0;
+}
+
+static std::pair<decltype(pointers)::const_iterator, decltype(pointers)::const_iterator> findPointersTo(lm_address_t target)
+{
+	return std::equal_range
+	(
+		pointers.begin(),
+		pointers.end(),
+		std::make_pair(target, lm_address_t(0)),
+		[](const auto& a, const auto& b) { return a.first < b.first; }
+	);
+}
+
+static unsigned int getRelocType(uintptr_t info)
+{
+	if constexpr (sizeof(info) == 4)
+		return ELF32_R_TYPE(info);
+	else
+		return ELF64_R_TYPE(info);
+}
+
+static unsigned int getRelocSymbol(uintptr_t info)
+{
+	if constexpr (sizeof(info) == 4)
+		return ELF32_R_SYM(info);
+	else
+		return ELF64_R_SYM(info);
+}
+
+///Summary:
+///Resolves R_386_32 relocations into relro against symbols defined in the module itself
+static void loadSymbolRelocs(const ElfW(Dyn)* dyn)
+{
+	lm_address_t symtab = LM_ADDRESS_BAD, rel = LM_ADDRESS_BAD;
+	size_t relSize = 0, relEntSize = 0;
+	bool rela = false;
+	for(; dyn->d_tag != DT_NULL; dyn++)
+	{
+		switch(dyn->d_tag)
+		{
+			case DT_SYMTAB:
+				symtab = normalize(dyn->d_un.d_ptr);
+				break;
+			case DT_REL:
+			case DT_RELA:
+				rel = normalize(dyn->d_un.d_ptr);
+				rela = dyn->d_tag == DT_RELA;
+				break;
+			case DT_RELSZ:
+			case DT_RELASZ:
+				relSize = dyn->d_un.d_val;
+				break;
+			case DT_RELENT:
+			case DT_RELAENT:
+				relEntSize = dyn->d_un.d_val;
+				break;
+		}
+	}
+
+	if (symtab == LM_ADDRESS_BAD || rel == LM_ADDRESS_BAD || !relEntSize)
+	{
+		return;
+	}
+
+	constexpr unsigned int R_ABS = 1; //R_386_32 and R_X86_64_64 for 64 bit builds of our tools
+	for(lm_address_t cur = rel; cur + relEntSize <= rel + relSize; cur += relEntSize)
+	{
+		//Rela only appends r_addend to Rel
+		const auto entry = reinterpret_cast<const ElfW(Rel)*>(cur);
+		const lm_address_t location = normalize(entry->r_offset);
+		if (getRelocType(entry->r_info) != R_ABS || !relro.contains(location))
+			continue;
+
+		const auto sym = reinterpret_cast<const ElfW(Sym)*>(symtab) + getRelocSymbol(entry->r_info);
+		if (sym->st_shndx == SHN_UNDEF)
+			continue;
+
+		const uintptr_t addend = rela ? reinterpret_cast<const ElfW(Rela)*>(cur)->r_addend : readWord(location);
+		symbolRelocs[location] = indexedModule.base + sym->st_value + addend;
+	}
+}
+
+bool RTTI::load(const lm_module_t& module)
+{
+	clear();
+	indexedModule = module;
+
+	const auto ehdr = reinterpret_cast<const ElfW(Ehdr)*>(module.base);
+	const auto phdrs = reinterpret_cast<const ElfW(Phdr)*>(module.base + ehdr->e_phoff);
+	const ElfW(Dyn)* dynamic = nullptr;
+	std::vector<CRange> code;
+	for(unsigned int i = 0; i < ehdr->e_phnum; i++)
+	{
+		if (phdrs[i].p_type == PT_DYNAMIC)
+		{
+			dynamic = reinterpret_cast<const ElfW(Dyn)*>(module.base + phdrs[i].p_vaddr);
+		}
+
+		const CRange range { module.base + phdrs[i].p_vaddr, module.base + phdrs[i].p_vaddr + phdrs[i].p_memsz };
+		if (phdrs[i].p_type == PT_GNU_RELRO)
+		{
+			relro = range;
+		}
+		else if (phdrs[i].p_type == PT_LOAD && (phdrs[i].p_flags & PF_X))
+		{
+			//Older linkers put .rodata into the same R-X segment as .text
+			if (!(phdrs[i].p_flags & PF_W))
+			{
+				code.emplace_back(range);
+			}
+		}
+		else if (phdrs[i].p_type == PT_LOAD)
+		{
+			data.emplace_back(range);
+			if (!(phdrs[i].p_flags & PF_W))
+			{
+				readOnly.emplace_back(range);
+			}
+		}
+	}
+	readOnly.insert(readOnly.end(), code.begin(), code.end());
+
+	if (relro.start == relro.end)
+	{
+		g_pLog->debug("%s has no RELRO segment to search for vtables in!\n", module.name);
+		return false;
+	}
+
+	if (dynamic)
+	{
+		loadSymbolRelocs(dynamic);
+	}
+
+	for(lm_address_t cur = relro.start; cur + sizeof(uintptr_t) <= relro.end; cur += sizeof(uintptr_t))
+	{
+		const lm_address_t target = readPointer(cur);
+		//Not indexing every pointer into code, vtables alone hold thousands of them
+		if (target != LM_ADDRESS_BAD && (isIn(data, target) || isTypeName(target)))
+		{
+			pointers.emplace_back(target, cur);
+		}
+	}
+
+	std::sort(pointers.begin(), pointers.end());
+	g_pLog->debug("Indexed %zu RTTI candidates in %s\n", pointers.size(), module.name);
+	return true;
+}
+
+void RTTI::clear()
+{
+	readOnly.clear();
+	data.clear();
+	relro = CRange {};
+	pointers.clear();
+	pointers.shrink_to_fit();
+	symbolRelocs.clear();
+}
+
+///Summary:
+///Checks whether the pointer to base at location is part of a class type info deriving from it.
+///Returns that type info and adds the offset of base within it to offset
+static lm_address_t getDerivedTypeInfo(lm_address_t location, intptr_t& offset)
+{
+	//__si_class_type_info, single public non virtual base at offset 0
+	const lm_address_t si = location - offsetof(CSIClassTypeInfo, base);
+	if (relro.contains(si) && isTypeName(readPointer(si + offsetof(CSIClassTypeInfo, name))))
+	{
+		return si;
+	}
+
+	//__vmi_class_type_info, try every position location could have in its base list
+	for(unsigned int i = 0; i < VMI_MAX_BASES; i++)
+	{
+		const lm_address_t vmi = location - sizeof(CVMIClassTypeInfo) - i * sizeof(CBaseClassInfo);
+		if (!relro.contains(vmi))
+			break;
+
+		const CVMIClassTypeInfo* info = reinterpret_cast<const CVMIClassTypeInfo*>(vmi);
+		if (info->flags > VMI_MAX_FLAGS || info->baseCount <= i || info->baseCount > VMI_MAX_BASES)
+			continue;
+
+		if (!isTypeName(readPointer(vmi + offsetof(CVMIClassTypeInfo, name))))
+			continue;
+
+		const CBaseClassInfo* base = reinterpret_cast<const CBaseClassInfo*>(location);
+		offset += base->offsetFlags >> BASE_OFFSET_SHIFT;
+		return vmi;
+	}
+
+	return LM_ADDRESS_BAD;
+}
+
+lm_address_t RTTI::findVTable(const char* className)
+{
+	if (pointers.empty())
+	{
+		return LM_ADDRESS_BAD;
+	}
+
+	const std::string mangled = std::to_string(strlen(className)).append(className);
+
+	//Type info of the interface itself through its name
+	lm_address_t typeInfo = LM_ADDRESS_BAD;
+	for(auto& range : readOnly)
+	{
+		const char* start = reinterpret_cast<const char*>(range.start);
+		const char* end = reinterpret_cast<const char*>(range.end);
+		for(const char* cur = start; typeInfo == LM_ADDRESS_BAD; cur++)
+		{
+			cur = static_cast<const char*>(memmem(cur, end - cur, mangled.c_str(), mangled.size() + 1));
+			if (!cur)
+				break;
+
+			if (cur != start && isdigit(cur[-1]))
+				continue;
+
+			auto [it, itEnd] = findPointersTo(reinterpret_cast<lm_address_t>(cur));
+			for(; it != itEnd; it++)
+			{
+				const lm_address_t candidate = it->second - offsetof(CTypeInfo, name);
+				if (relro.contains(candidate))
+				{
+					typeInfo = candidate;
+					break;
+				}
+			}
+		}
+	}
+
+	if (typeInfo == LM_ADDRESS_BAD)
+	{
+		g_pLog->debug("No type info for %s\n", className);
+		return LM_ADDRESS_BAD;
+	}
+
+	//Walk down every class deriving from it and collect the vtables of the leaves.
+	//Abstract classes in between may have vtables too, but nothing ever gets called through those
+	class CClass
+	{
+	public:
+		lm_address_t typeInfo;
+		intptr_t offset; //Of className within this class
+	};
+
+	auto classes = std::vector<CClass> { { typeInfo, 0 } };
+	auto vtables = std::vector<lm_address_t>();
+	for(size_t i = 0; i < classes.size() && classes.size() < VMI_MAX_BASES; i++)
+	{
+		const CClass current = classes.at(i);
+
+		bool hasDerived = false;
+		lm_address_t vtable = LM_ADDRESS_BAD;
+		auto [it, itEnd] = findPointersTo(current.typeInfo);
+		for(; it != itEnd; it++)
+		{
+			intptr_t offset = current.offset;
+			const lm_address_t derived = getDerivedTypeInfo(it->second, offset);
+			if (derived != LM_ADDRESS_BAD)
+			{
+				classes.emplace_back(CClass { derived, offset });
+				hasDerived = true;
+				continue;
+			}
+
+			//vtable: offset to top, type info, address point
+			if (static_cast<intptr_t>(readWord(it->second - sizeof(uintptr_t))) == -current.offset)
+			{
+				vtable = it->second + sizeof(uintptr_t);
+			}
+		}
+
+		if (!hasDerived && vtable != LM_ADDRESS_BAD && current.typeInfo != typeInfo)
+		{
+			vtables.emplace_back(vtable);
+		}
+	}
+
+	if (vtables.size() != 1)
+	{
+		g_pLog->debug("Found %zu implementations of %s instead of exactly one\n", vtables.size(), className);
+		return LM_ADDRESS_BAD;
+	}
+
+	g_pLog->debug("%s vtable at %p\n", className, vtables.front());
+	return vtables.front();
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "libmem/libmem.h"
+
+///Summary:
+///Finds vtables through the Itanium C++ ABI RTTI of a module. Works on freshly mapped modules
+///before ld.so relocated them, since pointers get accepted as link time and as runtime addresses
+namespace RTTI
+{
+	///Summary:
+	///Indexes every pointer in the module's RELRO segment which points into its data, once
+	bool load(const lm_module_t& module);
+	///Summary:
+	///Frees the index
+	void clear();
+
+	///Summary:
+	///Returns the address point of the vtable through which objects implementing className get
+	///called, or LM_ADDRESS_BAD if there is not exactly one implementation
+	lm_address_t findVTable(const char* className);
+}
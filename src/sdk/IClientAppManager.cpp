@@ -14,5 +14,3 @@ EAppState IClientAppManager::getAppInstallState(uint32_t appId)
 {
 	return MemHlp::callVFunc<EAppState(*)(void*, uint32_t)>(VFTIndexes::IClientAppManager::GetAppInstallState, this, appId);
 }
-
-IClientAppManager* g_pClientAppManager;
@@ -16,5 +16,3 @@ public:
 	bool installApp(uint32_t appId);
 	EAppState getAppInstallState(uint32_t appId);
 };
-
-extern IClientAppManager* g_pClientAppManager;
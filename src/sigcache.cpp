@@ -0,0 +1,238 @@
+#include "sigcache.hpp"
+
+#include "config.hpp"
+#include "hashcache.hpp"
+#include "log.hpp"
+#include "memhlp.hpp"
+#include "statspage.hpp"
+
+#include "yaml-cpp/yaml.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+CSigCache::CSigCache()
+{
+	this->moduleBase = LM_ADDRESS_BAD;
+	this->loaded = false;
+	this->stale = false;
+	this->dirty = false;
+}
+
+std::string CSigCache::getPath()
+{
+	return g_config.getDir().append("/sigcache.yaml");
+}
+
+bool CSigCache::load(const lm_module_t& module)
+{
+	moduleBase = module.base;
+	moduleId = MemHlp::getBuildId(module);
+	if (moduleId.empty())
+	{
+		//Fall back to hashing the file in case Valve ever strips the build-id.
+		//Runs before the config got loaded, but cached addresses get checked against the code anyway,
+		//so there's no need to honor ParanoidHashCheck here
+		try
+		{
+			moduleId = HashCache::getFileSHA256(module.path, false);
+		}
+		catch(std::runtime_error& err)
+		{
+			g_pLog->debug("Unable to identify %s, not using signature cache\n", module.name);
+			return false;
+		}
+	}
+
+	g_pLog->debug("%s identified as %s\n", module.name, moduleId.c_str());
+	loaded = true;
+
+	YAML::Node node;
+	try
+	{
+		node = YAML::LoadFile(getPath());
+	}
+	catch (YAML::Exception& ex)
+	{
+		//Missing on first start or after deleting it, nothing to worry about
+		g_pLog->debug("Unable to read signature cache: %s\n", ex.msg.c_str());
+		return false;
+	}
+
+	try
+	{
+		if (!node["ModuleId"] || node["ModuleId"].as<std::string>() != moduleId)
+		{
+			g_pLog->info("Signature cache is outdated, scanning near previous addresses\n");
+			stale = true;
+		}
+
+		for(const auto& sig : node["Signatures"])
+		{
+			CEntry entry {};
+			entry.matchRva = sig.second["Match"].as<lm_address_t>();
+			entry.rva = sig.second["Address"].as<lm_address_t>();
+
+			const auto statsNode = sig.second["Stats"];
+			if (statsNode)
+			{
+				for(unsigned int i = 0; i < static_cast<unsigned int>(SigScanResult::Count); i++)
+				{
+					const char* result = resultToStr(static_cast<SigScanResult>(i));
+					entry.stats[i] = statsNode[result] ? statsNode[result].as<unsigned int>() : 0;
+				}
+			}
+
+			entries[sig.first.as<std::string>()] = entry;
+		}
+	}
+	catch (YAML::Exception& ex)
+	{
+		g_pLog->debug("Failed to parse signature cache: %s\n", ex.msg.c_str());
+		entries.clear();
+		return false;
+	}
+
+	g_pLog->debug("Loaded %u entries from signature cache\n", entries.size());
+	return !stale;
+}
+
+bool CSigCache::save()
+{
+	if (!loaded || !dirty)
+	{
+		return true;
+	}
+
+	YAML::Emitter out;
+	out << YAML::BeginMap;
+	out << YAML::Key << "ModuleId" << YAML::Value << moduleId;
+	out << YAML::Key << "Signatures" << YAML::Value << YAML::BeginMap;
+	for(auto& entry : entries)
+	{
+		//Found, but following the match failed
+		if (entry.second.rva == LM_ADDRESS_BAD)
+			continue;
+
+		out << YAML::Key << entry.first << YAML::Value << YAML::BeginMap;
+		out << YAML::Key << "Match" << YAML::Value << entry.second.matchRva;
+		out << YAML::Key << "Address" << YAML::Value << entry.second.rva;
+
+		out << YAML::Key << "Stats" << YAML::Value << YAML::Flow << YAML::BeginMap;
+		for(unsigned int i = 0; i < static_cast<unsigned int>(SigScanResult::Count); i++)
+		{
+			out << YAML::Key << resultToStr(static_cast<SigScanResult>(i)) << YAML::Value << entry.second.stats[i];
+		}
+		out << YAML::EndMap;
+
+		out << YAML::EndMap;
+	}
+	out << YAML::EndMap;
+	out << YAML::EndMap;
+
+	std::ofstream file(getPath(), std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+	{
+		g_pLog->debug("Unable to write signature cache to %s!\n", getPath().c_str());
+		return false;
+	}
+
+	file << out.c_str() << "\n";
+	dirty = false;
+
+	g_pLog->debug("Saved %u entries to signature cache\n", entries.size());
+	return true;
+}
+
+lm_address_t CSigCache::find(const char* name, const char* signature, const lm_module_t& module)
+{
+	if (!loaded || stale || module.base != moduleBase || !entries.contains(name))
+	{
+		return LM_ADDRESS_BAD;
+	}
+
+	const CEntry& entry = entries.at(name);
+	if (entry.matchRva >= module.size || entry.rva >= module.size)
+	{
+		return LM_ADDRESS_BAD;
+	}
+
+	//Only check the signature bytes at the cached address instead of scanning the whole image
+	const MemHlp::CSignature sig(signature);
+	if (entry.matchRva + sig.bytes.size() > module.size || !sig.matches(module.base + entry.matchRva))
+	{
+		g_pLog->debug("Cached address of %s does not match anymore!\n", name);
+		return LM_ADDRESS_BAD;
+	}
+
+	return module.base + entry.rva;
+}
+
+void CSigCache::store(const char* name, const lm_module_t& module, lm_address_t match, lm_address_t address)
+{
+	if (!loaded || module.base != moduleBase)
+	{
+		return;
+	}
+
+	//Keep the stats of the previous builds around
+	CEntry& entry = entries[name];
+	if (entry.matchRva == match - module.base && entry.rva == address - module.base)
+	{
+		return;
+	}
+
+	entry.matchRva = match - module.base;
+	entry.rva = address - module.base;
+	dirty = true;
+}
+
+lm_address_t CSigCache::getHint(const char* name, const lm_module_t& module)
+{
+	if (!loaded || module.base != moduleBase || !entries.contains(name))
+	{
+		return LM_ADDRESS_BAD;
+	}
+
+	const lm_address_t matchRva = entries.at(name).matchRva;
+	if (matchRva >= module.size)
+	{
+		return LM_ADDRESS_BAD;
+	}
+
+	return module.base + matchRva;
+}
+
+void CSigCache::recordResult(const char* name, SigScanResult result)
+{
+	if (static_cast<unsigned int>(result) < StatsPage::SIG_RESULTS)
+	{
+		StatsPage::get()->sigScans[static_cast<unsigned int>(result)].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (!loaded)
+	{
+		return;
+	}
+
+	g_pLog->debug("Signature scan of %s: %s\n", name, resultToStr(result));
+
+	//Missing signatures only show up in the stats page, an entry would save a bogus address
+	if (result == SigScanResult::Missing)
+	{
+		return;
+	}
+
+	//Scans get recorded before store() knows where they resolved to
+	CEntry& entry = entries.try_emplace(name, CEntry { LM_ADDRESS_BAD, LM_ADDRESS_BAD, {} }).first->second;
+	entry.stats[static_cast<unsigned int>(result)]++;
+
+	//Hits alone are no reason to write the file on every start, they get saved along with the next miss
+	if (result != SigScanResult::Cached)
+	{
+		dirty = true;
+	}
+}
+
+CSigCache g_sigCache = CSigCache();
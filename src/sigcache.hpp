@@ -0,0 +1,77 @@
+#pragma once
+
+#include "libmem/libmem.h"
+#include "memory.hpp"
+
+#include <string>
+#include <unordered_map>
+
+enum class SigScanResult : unsigned int
+{
+	Cached, //Exact match from the cache of the same build
+	Near, //Found within the small window around the last known address
+	Far, //Found within the big window around the last known address
+	Full, //Had to scan the whole module
+	Missing,
+	Count
+};
+
+///Summary:
+///Remembers where signatures resolved to for a specific steamclient.so build, so we don't
+///have to scan the whole image on every start. Entries of older builds are kept as hints
+///where to start looking, since Steam updates usually only shift functions slightly
+class CSigCache
+{
+	class CEntry
+	{
+	public:
+		lm_address_t matchRva; //Where the signature itself matched
+		lm_address_t rva; //Where it resolved to after following it
+		unsigned int stats[static_cast<unsigned int>(SigScanResult::Count)];
+	};
+
+	std::string moduleId;
+	lm_address_t moduleBase;
+	std::unordered_map<std::string, CEntry, std::hash<std::string>, std::equal_to<std::string>, Memory::CAllocator<std::pair<const std::string, CEntry>, Memory::Subsystem::Caches>> entries;
+	bool loaded;
+	bool stale; //Entries are from a different build and only usable as hints
+	bool dirty;
+
+	constexpr const char* resultToStr(SigScanResult result)
+	{
+		switch(result)
+		{
+			case SigScanResult::Cached:
+				return "Cached";
+			case SigScanResult::Near:
+				return "Near";
+			case SigScanResult::Far:
+				return "Far";
+			case SigScanResult::Full:
+				return "Full";
+			case SigScanResult::Missing:
+				return "Missing";
+
+			default:
+				return "Unknown";
+		}
+	}
+
+public:
+	CSigCache();
+
+	std::string getPath();
+
+	bool load(const lm_module_t& module);
+	bool save();
+
+	lm_address_t find(const char* name, const char* signature, const lm_module_t& module);
+	void store(const char* name, const lm_module_t& module, lm_address_t match, lm_address_t address);
+
+	///Summary:
+	///Returns the address the signature matched at in the previous build or LM_ADDRESS_BAD
+	lm_address_t getHint(const char* name, const lm_module_t& module);
+	void recordResult(const char* name, SigScanResult result);
+};
+
+extern CSigCache g_sigCache;
@@ -0,0 +1,113 @@
+#include "statspage.hpp"
+
+#include "hookstats.hpp"
+#include "log.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static StatsPage::CLayout localPage;
+static StatsPage::CLayout* page = &localPage;
+static bool shared = false;
+
+StatsPage::CLayout* StatsPage::get()
+{
+	return page;
+}
+
+bool StatsPage::isShared()
+{
+	return shared;
+}
+
+bool StatsPage::init()
+{
+	if (shared)
+	{
+		return true;
+	}
+
+	char path[64];
+	getPath(path, sizeof(path), getpid());
+
+	int fd = shm_open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0)
+	{
+		g_pLog->debug("Unable to create stats page %s!\n", path);
+		return false;
+	}
+
+	if (ftruncate(fd, sizeof(CLayout)) != 0)
+	{
+		g_pLog->debug("Unable to resize stats page %s!\n", path);
+		::close(fd);
+		shm_unlink(path);
+		return false;
+	}
+
+	void* map = mmap(nullptr, sizeof(CLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+
+	if (map == MAP_FAILED)
+	{
+		g_pLog->debug("Unable to map stats page %s!\n", path);
+		shm_unlink(path);
+		return false;
+	}
+
+	//Everything counted so far carries over. Increments racing with the copy might get lost,
+	//but none of the counters in here are that precise anyway
+	CLayout* sharedPage = reinterpret_cast<CLayout*>(map);
+	memcpy(static_cast<void*>(sharedPage), &localPage, sizeof(CLayout));
+
+	const unsigned int hookCount = HookStats::getHookCount() < MAX_HOOKS ? HookStats::getHookCount() : MAX_HOOKS;
+	for(unsigned int i = 0; i < hookCount; i++)
+	{
+		snprintf(sharedPage->hooks[i].name, NAME_SIZE, "%s", HookStats::getHookName(i));
+	}
+	sharedPage->hookCount.store(hookCount, std::memory_order_relaxed);
+
+	sharedPage->size = sizeof(CLayout);
+	sharedPage->pid = getpid();
+	sharedPage->version = VERSION;
+	//Written last, so readers never see a valid magic with a partially filled header
+	std::atomic_thread_fence(std::memory_order_release);
+	sharedPage->magic = MAGIC;
+
+	page = sharedPage;
+	shared = true;
+
+	g_pLog->info("Publishing stats at /dev/shm%s\n", path);
+	return true;
+}
+
+void StatsPage::close()
+{
+	if (!shared)
+	{
+		return;
+	}
+
+	char path[64];
+	getPath(path, sizeof(path), getpid());
+	shm_unlink(path);
+
+	//Keep the mapping, hooks might still be counting into it
+	g_pLog->debug("Removed stats page %s\n", path);
+}
+
+void StatsPage::setPhase(const char* name, uint64_t durationNs)
+{
+	const uint32_t idx = page->phaseCount.load(std::memory_order_relaxed);
+	if (idx >= MAX_PHASES)
+	{
+		return;
+	}
+
+	snprintf(page->phases[idx].name, NAME_SIZE, "%s", name);
+	page->phases[idx].durationNs = durationNs;
+	page->phaseCount.store(idx + 1, std::memory_order_release);
+}
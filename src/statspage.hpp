@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+///Summary:
+///Fixed layout stats block SLSsteam publishes at /dev/shm/SLSsteam-<pid> for slsstat.
+///Bump VERSION whenever the layout changes
+namespace StatsPage
+{
+	constexpr uint32_t MAGIC = 0x53534C53; //SLSS
+	constexpr uint32_t VERSION = 2;
+
+	constexpr unsigned int MAX_HOOKS = 32;
+	constexpr unsigned int MAX_PHASES = 48;
+	constexpr unsigned int NAME_SIZE = 64;
+	constexpr unsigned int SIG_RESULTS = 5; //Same order as SigScanResult
+	constexpr unsigned int MEMORY_SUBSYSTEMS = 5; //Same order as Memory::Subsystem
+
+	class CHook
+	{
+	public:
+		char name[NAME_SIZE];
+		std::atomic<uint64_t> calls;
+	};
+
+	class CPhase
+	{
+	public:
+		char name[NAME_SIZE];
+		uint64_t durationNs;
+	};
+
+	class CLayout
+	{
+	public:
+		uint32_t magic;
+		uint32_t version;
+		uint32_t size; //sizeof(CLayout), in case bitness of reader and writer differ
+		uint32_t pid;
+
+		std::atomic<uint32_t> configGeneration;
+		std::atomic<uint32_t> hashCacheHits;
+		std::atomic<uint32_t> hashCacheMisses;
+		std::atomic<uint32_t> hookCount;
+		std::atomic<uint64_t> sigScans[SIG_RESULTS];
+
+		std::atomic<uint64_t> logLines;
+		std::atomic<uint64_t> logOnceDropped; //Duplicate messages CLog::once did not write
+		std::atomic<uint64_t> logOnceEvictions; //Times msgCache outgrew the Log budget and got dropped
+
+		std::atomic<uint64_t> memoryBytes[MEMORY_SUBSYSTEMS];
+		std::atomic<uint64_t> memoryPeak[MEMORY_SUBSYSTEMS];
+
+		std::atomic<uint32_t> phaseCount;
+		uint32_t _pad;
+		uint64_t startupTotalNs;
+		CPhase phases[MAX_PHASES];
+
+		CHook hooks[MAX_HOOKS];
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "Stats page needs lock free 64 bit atomics to be shared between processes");
+
+	///Summary:
+	///Counters always go into a process local block first. init() moves it into shared memory
+	CLayout* get();
+	bool isShared();
+
+	///Summary:
+	///Name for shm_open, shared with slsstat
+	inline void getPath(char* buf, unsigned int size, uint32_t pid)
+	{
+		snprintf(buf, size, "/SLSsteam-%u", pid);
+	}
+
+	bool init();
+	void close();
+
+	void setPhase(const char* name, uint64_t durationNs);
+
+	inline void countHookCall(unsigned int id)
+	{
+		//Hook calls are the only hot counter, so they're only counted when someone can read them
+		if (isShared() && id < MAX_HOOKS)
+		{
+			get()->hooks[id].calls.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
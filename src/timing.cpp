@@ -0,0 +1,153 @@
+#include "timing.hpp"
+
+#include "log.hpp"
+#include "statspage.hpp"
+#include "tracer.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class CPhase
+{
+public:
+	std::string name;
+	uint64_t start; //First time this phase started
+	uint64_t duration; //Summed up over all occurences
+	unsigned int count;
+};
+
+static std::mutex mutex;
+static std::vector<CPhase> phases;
+
+//Stages that run sequentially on the loader's thread, everything else overlaps with them
+static constexpr const char* wallPhases[] = { "processCheck", "setup", "load" };
+
+uint64_t Timing::now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void Timing::record(const std::string& phase, uint64_t start, uint64_t end)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for(auto& cur : phases)
+	{
+		if (cur.name == phase)
+		{
+			cur.duration += end - start;
+			cur.count++;
+			return;
+		}
+	}
+
+	phases.emplace_back(CPhase { phase, start, end - start, 1 });
+}
+
+Timing::CScope::CScope(std::string phase) : phase(std::move(phase))
+{
+	this->traceName = Tracer::isRecording() ? Tracer::intern(this->phase) : nullptr;
+	if (this->traceName)
+	{
+		Tracer::begin(this->traceName);
+	}
+
+	this->start = Timing::now();
+}
+
+Timing::CScope::~CScope()
+{
+	Timing::record(phase, start, Timing::now());
+
+	if (traceName)
+	{
+		Tracer::end(traceName);
+	}
+}
+
+uint64_t Timing::getTotal()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	uint64_t total = 0;
+	for(auto& phase : phases)
+	{
+		for(auto wallPhase : wallPhases)
+		{
+			if (phase.name == wallPhase)
+			{
+				total += phase.duration;
+			}
+		}
+	}
+
+	return total;
+}
+
+void Timing::logSummary()
+{
+	const uint64_t total = getTotal();
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::string summary;
+	char buf[256];
+	for(auto& phase : phases)
+	{
+		snprintf(buf, sizeof(buf), " %s=%.3fms", phase.name.c_str(), phase.duration / 1e6);
+		summary.append(buf);
+		StatsPage::setPhase(phase.name.c_str(), phase.duration);
+
+		if (phase.count > 1)
+		{
+			snprintf(buf, sizeof(buf), "(x%u)", phase.count);
+			summary.append(buf);
+		}
+	}
+
+	StatsPage::get()->startupTotalNs = total;
+	g_pLog->info("Startup timings: total=%.3fms%s\n", total / 1e6, summary.c_str());
+}
+
+bool Timing::writeJson(const char* path)
+{
+	const uint64_t total = getTotal();
+
+	FILE* file = fopen(path, "w");
+	if (!file)
+	{
+		g_pLog->debug("Unable to write startup timings to %s!\n", path);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const uint64_t origin = phases.empty() ? 0 : phases.front().start;
+
+	fprintf(file, "{\n\t\"total_ms\": %.3f,\n\t\"phases\": [\n", total / 1e6);
+	for(size_t i = 0; i < phases.size(); i++)
+	{
+		auto& phase = phases.at(i);
+		//Phase names are our own identifiers, so there's nothing to escape
+		fprintf
+		(
+			file,
+			"\t\t{ \"name\": \"%s\", \"start_ms\": %.3f, \"duration_ms\": %.3f, \"count\": %u }%s\n",
+			phase.name.c_str(),
+			(phase.start - origin) / 1e6,
+			phase.duration / 1e6,
+			phase.count,
+			i + 1 < phases.size() ? "," : ""
+		);
+	}
+	fprintf(file, "\t]\n}\n");
+
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+///Summary:
+///Monotonic timestamps of SLSsteam's startup phases, so we can see how much we add to Steam's launch
+namespace Timing
+{
+	uint64_t now();
+
+	///Summary:
+	///Adds a finished phase. Phases with the same name get summed up. Thread safe
+	void record(const std::string& phase, uint64_t start, uint64_t end);
+
+	class CScope
+	{
+		std::string phase;
+		uint64_t start;
+		const char* traceName;
+
+	public:
+		CScope(std::string phase);
+		~CScope();
+	};
+
+	///Summary:
+	///Total time SLSsteam itself took, excluding what Steam does between la_preinit and loading steamclient.so
+	uint64_t getTotal();
+
+	void logSummary();
+	bool writeJson(const char* path);
+}
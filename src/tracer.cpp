@@ -0,0 +1,217 @@
+#include "tracer.hpp"
+
+#include "config.hpp"
+#include "log.hpp"
+#include "memory.hpp"
+#include "timing.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_set>
+
+class CEvent
+{
+public:
+	const char* name;
+	uint64_t timestamp;
+	char phase; //B or E like in the trace event format
+};
+
+class CThreadBuffer
+{
+public:
+	CEvent events[Tracer::EVENTS_PER_THREAD];
+	//Published with release after writing an event, so the writer never sees half written ones
+	std::atomic<unsigned int> count;
+	std::atomic<unsigned int> dropped;
+	uint32_t tid;
+	char threadName[16];
+	CThreadBuffer* next;
+};
+
+static std::atomic<bool> recording;
+//From start() until the window closed, covers TraceDelay too
+static std::atomic<bool> tracing;
+static std::atomic<CThreadBuffer*> buffers;
+static thread_local CThreadBuffer* threadBuffer;
+
+static std::mutex internMutex;
+static std::unordered_set<std::string> internedNames;
+
+static CThreadBuffer* getThreadBuffer()
+{
+	if (!threadBuffer)
+	{
+		threadBuffer = new CThreadBuffer();
+		Memory::add(Memory::Subsystem::Profiling, sizeof(CThreadBuffer));
+		threadBuffer->tid = syscall(SYS_gettid);
+		pthread_getname_np(pthread_self(), threadBuffer->threadName, sizeof(threadBuffer->threadName));
+
+		threadBuffer->next = buffers.load(std::memory_order_relaxed);
+		while(!buffers.compare_exchange_weak(threadBuffer->next, threadBuffer, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	return threadBuffer;
+}
+
+static void addEvent(const char* name, char phase)
+{
+	CThreadBuffer* buffer = getThreadBuffer();
+
+	const unsigned int idx = buffer->count.load(std::memory_order_relaxed);
+	if (idx >= Tracer::EVENTS_PER_THREAD)
+	{
+		buffer->dropped.store(buffer->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return;
+	}
+
+	buffer->events[idx] = CEvent { name, Timing::now(), phase };
+	buffer->count.store(idx + 1, std::memory_order_release);
+}
+
+///Summary:
+///Writes name as JSON string contents. Names are ours, so only quotes and backslashes need care
+static void writeEscaped(FILE* file, const char* name)
+{
+	for(const char* c = name; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			fputc('\\', file);
+
+		fputc(*c, file);
+	}
+}
+
+static void writeTrace()
+{
+	const std::string path = g_config.getDir().append("/trace.json");
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file)
+	{
+		g_pLog->debug("Unable to write trace to %s!\n", path.c_str());
+		return;
+	}
+
+	const int pid = getpid();
+	unsigned long long events = 0, dropped = 0;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%i,\"tid\":%i,\"args\":{\"name\":\"steam (SLSsteam)\"}}", pid, pid);
+
+	for(CThreadBuffer* cur = buffers.load(std::memory_order_acquire); cur; cur = cur->next)
+	{
+		const unsigned int count = cur->count.load(std::memory_order_acquire);
+		if (!count)
+			continue;
+
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%i,\"tid\":%u,\"args\":{\"name\":\"", pid, cur->tid);
+		writeEscaped(file, cur->threadName);
+		fprintf(file, "\"}}");
+
+		for(unsigned int i = 0; i < count; i++)
+		{
+			const CEvent& event = cur->events[i];
+
+			fprintf(file, ",\n{\"name\":\"");
+			writeEscaped(file, event.name);
+			fprintf
+			(
+				file,
+				"\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":%i,\"tid\":%u}",
+				event.phase,
+				static_cast<unsigned long long>(event.timestamp / 1000),
+				static_cast<unsigned int>(event.timestamp % 1000),
+				pid,
+				cur->tid
+			);
+		}
+
+		events += count;
+		dropped += cur->dropped.load(std::memory_order_relaxed);
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	g_pLog->info("Wrote %llu trace events to %s (%llu dropped)\n", events, path.c_str(), dropped);
+}
+
+void Tracer::start(void(*onFinished)())
+{
+	if (!g_config.traceDuration)
+	{
+		return;
+	}
+
+	tracing.store(true, std::memory_order_relaxed);
+	std::thread([onFinished]()
+	{
+		pthread_setname_np(pthread_self(), "SLSsteam tracer");
+
+		std::this_thread::sleep_for(std::chrono::seconds(g_config.traceDelay));
+		g_pLog->info("Tracing for %u seconds\n", g_config.traceDuration);
+		recording.store(true, std::memory_order_relaxed);
+
+		std::this_thread::sleep_for(std::chrono::seconds(g_config.traceDuration));
+		recording.store(false, std::memory_order_relaxed);
+
+		//Let hooks which are still running append their end events
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		writeTrace();
+
+		tracing.store(false, std::memory_order_relaxed);
+		onFinished();
+	}).detach();
+}
+
+bool Tracer::isTracing()
+{
+	return tracing.load(std::memory_order_relaxed);
+}
+
+bool Tracer::isRecording()
+{
+	return recording.load(std::memory_order_relaxed);
+}
+
+const char* Tracer::intern(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(internMutex);
+	return internedNames.emplace(name).first->c_str();
+}
+
+void Tracer::begin(const char* name)
+{
+	addEvent(name, 'B');
+}
+
+void Tracer::end(const char* name)
+{
+	addEvent(name, 'E');
+}
+
+Tracer::CScope::CScope(const char* name)
+{
+	this->name = isRecording() ? name : nullptr;
+	if (this->name)
+	{
+		begin(this->name);
+	}
+}
+
+Tracer::CScope::~CScope()
+{
+	//Ending even if the window closed in between, otherwise the viewer shows the call as never finishing
+	if (name)
+	{
+		end(name);
+	}
+}
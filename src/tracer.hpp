@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+///Summary:
+///Opt-in timeline of hook calls and SLSsteam's own tasks. Every thread records begin/end events
+///into its own buffer during the configured window, afterwards everything gets written to
+///trace.json in the config directory as Chrome trace events (open it in ui.perfetto.dev)
+namespace Tracer
+{
+	constexpr unsigned int EVENTS_PER_THREAD = 64 * 1024;
+
+	///Summary:
+	///Starts the background thread which opens the window after TraceDelay for TraceDuration seconds.
+	///Calls onFinished once trace.json got written
+	void start(void(*onFinished)());
+	///Summary:
+	///True from start() until the window closed, while isRecording() only covers the window itself
+	bool isTracing();
+	bool isRecording();
+
+	///Summary:
+	///Returns a pointer to a copy of name which lives until the process exits
+	const char* intern(const std::string& name);
+
+	///Summary:
+	///name has to outlive the tracer, use intern() for temporary strings
+	void begin(const char* name);
+	void end(const char* name);
+
+	class CScope
+	{
+		const char* name;
+
+	public:
+		CScope(const char* name);
+		~CScope();
+
+		CScope(const CScope&) = delete;
+		CScope& operator=(const CScope&) = delete;
+	};
+}
@@ -1,12 +1,19 @@
 #include "utils.hpp"
+#include "log.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <cstring>
-#include <fstream>
-#include <iomanip>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
-#include <openssl/sha.h>
+#include <openssl/evp.h>
 
 std::vector<std::string> Utils::strsplit(char *str, const char *delimeter)
 {
@@ -31,24 +38,91 @@ std::vector<std::string> Utils::strsplit(char *str, const char *delimeter)
 
 std::string Utils::getFileSHA256(const char *filePath)
 {
-	std::ifstream fs(filePath, std::ios::binary);
-	if (!fs.is_open())
+	int fd = open(filePath, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
 	{
 		//TODO: Read more about error types in C++ :)
 		throw std::runtime_error("Unable to read file!");
 	}
 
-	std::vector<unsigned char> bytes(std::istreambuf_iterator<char>(fs), {});
-	unsigned char sha256Bytes[SHA256_DIGEST_LENGTH];
-	SHA256(bytes.data(), bytes.size(), sha256Bytes);
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		close(fd);
+		throw std::runtime_error("Unable to stat file!");
+	}
 
-	std::stringstream sha256;
-	for(int i = 0; i < SHA256_DIGEST_LENGTH; i++)
+	const auto start = std::chrono::steady_clock::now();
+	const size_t size = st.st_size;
+
+	EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+	if (!ctx || !EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr))
 	{
-		sha256 << std::hex << std::setw(2) << std::setfill('0') << (int)sha256Bytes[i];
+		EVP_MD_CTX_free(ctx);
+		close(fd);
+		throw std::runtime_error("Unable to initialize SHA256!");
 	}
 
-	fs.close();
-	return sha256.str();
-}
+	//Feed the digest in chunks and drop what we already hashed, so memory usage stays
+	//constant no matter how big the file is
+	constexpr size_t chunkSize = 4 * 1024 * 1024;
+	bool success = true;
+
+	void* map = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	if (map != MAP_FAILED)
+	{
+		madvise(map, size, MADV_SEQUENTIAL);
+
+		for(size_t offset = 0; offset < size && success; offset += chunkSize)
+		{
+			const size_t len = std::min(chunkSize, size - offset);
+			success = EVP_DigestUpdate(ctx, reinterpret_cast<unsigned char*>(map) + offset, len);
+			madvise(reinterpret_cast<unsigned char*>(map) + offset, len, MADV_DONTNEED);
+		}
+
+		munmap(map, size);
+	}
+	else
+	{
+		//Empty files can't be mapped and there might be filesystems not supporting it
+		auto buffer = std::make_unique<unsigned char[]>(chunkSize);
+		for(;;)
+		{
+			const ssize_t len = read(fd, buffer.get(), chunkSize);
+			if (len <= 0)
+			{
+				success = len == 0;
+				break;
+			}
 
+			if (!EVP_DigestUpdate(ctx, buffer.get(), len))
+			{
+				success = false;
+				break;
+			}
+		}
+	}
+
+	close(fd);
+
+	unsigned char sha256Bytes[EVP_MAX_MD_SIZE];
+	unsigned int sha256Size = 0;
+	success = success && EVP_DigestFinal_ex(ctx, sha256Bytes, &sha256Size);
+	EVP_MD_CTX_free(ctx);
+
+	if (!success)
+	{
+		throw std::runtime_error("Unable to hash file!");
+	}
+
+	const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	g_pLog->debug("Hashed %u bytes of %s in %.2fms (%.1f MiB/s)\n", size, filePath, ms, ms > 0 ? size / 1048576.0 / (ms / 1000) : 0.0);
+
+	char hex[EVP_MAX_MD_SIZE * 2 + 1];
+	for(unsigned int i = 0; i < sha256Size; i++)
+	{
+		snprintf(hex + i * 2, 3, "%02x", sha256Bytes[i]);
+	}
+
+	return std::string(hex, sha256Size * 2);
+}
@@ -0,0 +1,315 @@
+#include "x86.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+//Operand flags per opcode
+enum : uint8_t
+{
+	NONE = 0,
+	MODRM = 1 << 0,
+	IMM8 = 1 << 1,
+	IMM16 = 1 << 2,
+	IMMZ = 1 << 3, //16 or 32 bit depending on operand size
+	MOFFS = 1 << 4, //16 or 32 bit depending on address size
+	FARPTR = 1 << 5, //IMMZ + 16 bit segment
+	GROUP3 = 1 << 6, //test r/m, imm only has an immediate for /0 and /1
+	INVALID = 1 << 7
+};
+
+#define M MODRM
+#define I8 IMM8
+#define IZ IMMZ
+#define MI8 (MODRM | IMM8)
+#define MIZ (MODRM | IMMZ)
+#define X INVALID
+
+static constexpr uint8_t oneByteOps[256] =
+{
+	//0     1     2     3     4     5     6     7     8     9     A     B     C     D     E     F
+	M,    M,    M,    M,    I8,   IZ,   NONE, NONE, M,    M,    M,    M,    I8,   IZ,   NONE, X,    //0x00 (0F escape handled separately)
+	M,    M,    M,    M,    I8,   IZ,   NONE, NONE, M,    M,    M,    M,    I8,   IZ,   NONE, NONE, //0x10
+	M,    M,    M,    M,    I8,   IZ,   X,    NONE, M,    M,    M,    M,    I8,   IZ,   X,    NONE, //0x20
+	M,    M,    M,    M,    I8,   IZ,   X,    NONE, M,    M,    M,    M,    I8,   IZ,   X,    NONE, //0x30
+	NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, //0x40
+	NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, //0x50
+	NONE, NONE, M,    M,    X,    X,    X,    X,    IZ,   MIZ,  I8,   MI8,  NONE, NONE, NONE, NONE, //0x60
+	I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   //0x70
+	MI8,  MIZ,  MI8,  MI8,  M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    //0x80
+	NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, FARPTR, NONE, NONE, NONE, NONE, NONE, //0x90
+	MOFFS, MOFFS, MOFFS, MOFFS, NONE, NONE, NONE, NONE, I8, IZ, NONE, NONE, NONE, NONE, NONE, NONE,   //0xA0
+	I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   IZ,   IZ,   IZ,   IZ,   IZ,   IZ,   IZ,   IZ,   //0xB0
+	MI8,  MI8,  IMM16, NONE, M,   M,    MI8,  MIZ,  IMM16 | I8, NONE, IMM16, NONE, NONE, I8, NONE, NONE, //0xC0
+	M,    M,    M,    M,    I8,   I8,   NONE, NONE, M,    M,    M,    M,    M,    M,    M,    M,    //0xD0
+	I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   IZ,   IZ,   FARPTR, I8, NONE, NONE, NONE, NONE, //0xE0
+	X,    NONE, X,    X,    NONE, NONE, M | GROUP3, M | GROUP3, NONE, NONE, NONE, NONE, NONE, NONE, M, M //0xF0 (prefixes handled separately)
+};
+
+static constexpr uint8_t twoByteOps[256] =
+{
+	//0     1     2     3     4     5     6     7     8     9     A     B     C     D     E     F
+	M,    M,    M,    M,    X,    NONE, NONE, NONE, NONE, NONE, X,    NONE, X,    M,    NONE, MI8,  //0x00
+	M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    //0x10
+	M,    M,    M,    M,    X,    X,    X,    X,    M,    M,    M,    M,    M,    M,    M,    M,    //0x20
+	NONE, NONE, NONE, NONE, NONE, NONE, X,    NONE, X,    X,    X,    X,    X,    X,    X,    X,    //0x30 (38 & 3A handled separately)
+	M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    //0x40
+	M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    //0x50
+	M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    //0x60
+	MI8,  MI8,  MI8,  MI8,  M,    M,    M,    NONE, M,    M,    X,    X,    M,    M,    M,    M,    //0x70
+	IZ,   IZ,   IZ,   IZ,   IZ,   IZ,   IZ,   IZ,   IZ,   IZ,   IZ,   IZ,   IZ,   IZ,   IZ,   IZ,   //0x80
+	M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    //0x90
+	NONE, NONE, NONE, M,    MI8,  M,    X,    X,    NONE, NONE, NONE, M,    MI8,  M,    M,    M,    //0xA0
+	M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    MI8,  M,    M,    M,    M,    M,    //0xB0
+	M,    M,    MI8,  M,    MI8,  MI8,  MI8,  M,    NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE, //0xC0
+	M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    //0xD0
+	M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    //0xE0
+	M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M     //0xF0
+};
+
+#undef M
+#undef I8
+#undef IZ
+#undef MI8
+#undef MIZ
+#undef X
+
+///Summary:
+///Returns the size of ModRM, SIB and displacement or 0 on failure
+static size_t getModRMLength(const lm_byte_t* code, bool addr16)
+{
+	const lm_byte_t modrm = code[0];
+	const lm_byte_t mod = modrm >> 6;
+	const lm_byte_t rm = modrm & 7;
+
+	if (mod == 3)
+	{
+		return 1;
+	}
+
+	if (addr16)
+	{
+		if (mod == 0)
+			return rm == 6 ? 3 : 1;
+
+		return mod == 1 ? 2 : 3;
+	}
+
+	size_t size = 1;
+	if (rm == 4)
+	{
+		size++;
+
+		//No base register, disp32 instead
+		if (mod == 0 && (code[1] & 7) == 5)
+			return size + 4;
+	}
+	else if (mod == 0 && rm == 5)
+	{
+		return size + 4;
+	}
+
+	if (mod == 1)
+		size += 1;
+	else if (mod == 2)
+		size += 4;
+
+	return size;
+}
+
+size_t X86::getInstLength(const lm_byte_t* code)
+{
+	const lm_byte_t* cur = code;
+	bool opSize16 = false;
+	bool addrSize16 = false;
+
+	//Prefixes
+	for(;; cur++)
+	{
+		if (cur - code >= static_cast<ptrdiff_t>(LM_INST_MAX))
+		{
+			return 0;
+		}
+
+		switch(*cur)
+		{
+			case 0x66:
+				opSize16 = true;
+				continue;
+			case 0x67:
+				addrSize16 = true;
+				continue;
+			case 0xF0:
+			case 0xF2:
+			case 0xF3:
+			case 0x26:
+			case 0x2E:
+			case 0x36:
+			case 0x3E:
+			case 0x64:
+			case 0x65:
+				continue;
+		}
+
+		break;
+	}
+
+	const lm_byte_t op = *cur++;
+	uint8_t flags;
+
+	if (op == 0x0F)
+	{
+		const lm_byte_t op2 = *cur++;
+		if (op2 == 0x38)
+		{
+			cur++;
+			flags = MODRM;
+		}
+		else if (op2 == 0x3A)
+		{
+			cur++;
+			flags = MODRM | IMM8;
+		}
+		else
+		{
+			flags = twoByteOps[op2];
+		}
+	}
+	else if ((op == 0xC4 || op == 0xC5) && (cur[0] & 0xC0) == 0xC0)
+	{
+		//VEX, in 32 bit mode LES/LDS can not have a register operand
+		lm_byte_t map = 1;
+		if (op == 0xC4)
+		{
+			map = cur[0] & 0x1F;
+			cur += 2;
+		}
+		else
+		{
+			cur += 1;
+		}
+
+		const lm_byte_t vexOp = *cur++;
+		switch(map)
+		{
+			case 1:
+				flags = twoByteOps[vexOp];
+				break;
+			case 2:
+				flags = MODRM;
+				break;
+			case 3:
+				flags = MODRM | IMM8;
+				break;
+
+			default:
+				return 0;
+		}
+	}
+	else
+	{
+		flags = oneByteOps[op];
+	}
+
+	if (flags & INVALID)
+	{
+		return 0;
+	}
+
+	if (flags & MODRM)
+	{
+		if ((flags & GROUP3) && ((cur[0] >> 3) & 7) < 2)
+		{
+			flags |= op == 0xF6 ? IMM8 : IMMZ;
+		}
+
+		cur += getModRMLength(cur, addrSize16);
+	}
+
+	if (flags & IMM8)
+		cur += 1;
+	if (flags & IMM16)
+		cur += 2;
+	if (flags & IMMZ)
+		cur += opSize16 ? 2 : 4;
+	if (flags & MOFFS)
+		cur += addrSize16 ? 2 : 4;
+	if (flags & FARPTR)
+		cur += (opSize16 ? 2 : 4) + 2;
+
+	const size_t size = cur - code;
+	return size <= LM_INST_MAX ? size : 0;
+}
+
+lm_address_t X86::getBranchTarget(lm_address_t address)
+{
+	const lm_byte_t* code = reinterpret_cast<const lm_byte_t*>(address);
+	switch(code[0])
+	{
+		case 0xE8:
+		case 0xE9:
+		{
+			int32_t rel;
+			memcpy(&rel, code + 1, sizeof(rel));
+			return address + JMP_REL32_SIZE + rel;
+		}
+		case 0xEB:
+			return address + 2 + static_cast<int8_t>(code[1]);
+
+		default:
+			return LM_ADDRESS_BAD;
+	}
+}
+
+bool X86::isMovRegFromStackTop(const lm_byte_t* code, Register& reg)
+{
+	//8B /r with mod 00, rm 100 (SIB) and SIB 24 (base esp, no index)
+	if (code[0] != 0x8B || (code[1] & 0xC7) != 0x04 || code[2] != 0x24)
+	{
+		return false;
+	}
+
+	reg = static_cast<Register>((code[1] >> 3) & 7);
+	return true;
+}
+
+static size_t encodeRel32(lm_byte_t* out, lm_byte_t op, lm_address_t from, lm_address_t to)
+{
+	const int32_t rel = static_cast<int32_t>(to - from - 5);
+
+	out[0] = op;
+	memcpy(out + 1, &rel, sizeof(rel));
+	return 5;
+}
+
+size_t X86::encodeJmp(lm_byte_t* out, lm_address_t from, lm_address_t to)
+{
+	return encodeRel32(out, 0xE9, from, to);
+}
+
+size_t X86::encodeCall(lm_byte_t* out, lm_address_t from, lm_address_t to)
+{
+	return encodeRel32(out, 0xE8, from, to);
+}
+
+size_t X86::encodeMovMemReg(lm_byte_t* out, lm_address_t mem, Register reg)
+{
+	const uint32_t disp = static_cast<uint32_t>(mem);
+
+	out[0] = 0x89;
+	out[1] = static_cast<lm_byte_t>((reg << 3) | 0x05); //mod 00, rm 101 -> [disp32]
+	memcpy(out + 2, &disp, sizeof(disp));
+	return MOV_MEM_REG_SIZE;
+}
+
+size_t X86::encodeMovRegImm(lm_byte_t* out, Register reg, uint32_t imm)
+{
+	out[0] = static_cast<lm_byte_t>(0xB8 + reg);
+	memcpy(out + 1, &imm, sizeof(imm));
+	return MOV_REG_IMM32_SIZE;
+}
+
+size_t X86::encodeRet(lm_byte_t* out)
+{
+	out[0] = 0xC3;
+	return RET_SIZE;
+}
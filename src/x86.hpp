@@ -0,0 +1,55 @@
+#pragma once
+
+#include "libmem/libmem.h"
+
+#include <cstddef>
+#include <cstdint>
+
+///Summary:
+///Minimal x86-32 instruction length decoder and encoder for the few instructions we emit.
+///Avoids going through capstone/keystone and their string formatting while placing hooks
+namespace X86
+{
+	enum Register : lm_byte_t
+	{
+		EAX = 0,
+		ECX,
+		EDX,
+		EBX,
+		ESP,
+		EBP,
+		ESI,
+		EDI
+	};
+
+	constexpr size_t JMP_REL32_SIZE = 5;
+	constexpr size_t CALL_REL32_SIZE = 5;
+	constexpr size_t MOV_MEM_REG_SIZE = 6;
+	constexpr size_t MOV_REG_IMM32_SIZE = 5;
+	constexpr size_t RET_SIZE = 1;
+
+	///Summary:
+	///Returns the length of the instruction at code or 0 if it can not be decoded
+	size_t getInstLength(const lm_byte_t* code);
+
+	constexpr bool isRet(const lm_byte_t* code)
+	{
+		return code[0] == 0xC3 || code[0] == 0xC2;
+	}
+
+	///Summary:
+	///Resolves jmp/call rel8/rel32 at address. Returns LM_ADDRESS_BAD for anything else
+	lm_address_t getBranchTarget(lm_address_t address);
+
+	///Summary:
+	///Matches mov reg, [esp] which is what PIC thunks like __x86.get_pc_thunk.bx consist of besides their ret
+	bool isMovRegFromStackTop(const lm_byte_t* code, Register& reg);
+
+	//Encoders write to out and return the amount of bytes written.
+	//from is the address the instruction is going to be executed at
+	size_t encodeJmp(lm_byte_t* out, lm_address_t from, lm_address_t to);
+	size_t encodeCall(lm_byte_t* out, lm_address_t from, lm_address_t to);
+	size_t encodeMovMemReg(lm_byte_t* out, lm_address_t mem, Register reg);
+	size_t encodeMovRegImm(lm_byte_t* out, Register reg, uint32_t imm);
+	size_t encodeRet(lm_byte_t* out);
+}
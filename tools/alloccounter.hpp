@@ -0,0 +1,98 @@
+#pragma once
+
+//Counts heap allocations of everything running in the default link namespace, including libraries we dlopen.
+//Defines malloc and friends, so only include it in the one translation unit of a tool
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+extern "C"
+{
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* ptr, size_t size);
+	void* __libc_memalign(size_t alignment, size_t size);
+	void __libc_free(void* ptr);
+}
+
+namespace AllocCounter
+{
+	//Only the thread which called start() counts, so background threads don't show up as noise
+	static thread_local bool counting;
+	static std::atomic<uint64_t> allocations;
+	static std::atomic<void*> firstCaller;
+	static std::atomic<size_t> firstSize;
+
+	__attribute__((always_inline))
+	static inline void count(size_t size, void* caller)
+	{
+		if (!counting)
+		{
+			return;
+		}
+
+		if (allocations.fetch_add(1, std::memory_order_relaxed) == 0)
+		{
+			firstCaller.store(caller, std::memory_order_relaxed);
+			firstSize.store(size, std::memory_order_relaxed);
+		}
+	}
+
+	///Summary:
+	///Counts from now on, adding to what previous start()/stop() pairs counted
+	static inline void start()
+	{
+		counting = true;
+	}
+
+	///Summary:
+	///Returns everything counted so far
+	static inline uint64_t stop()
+	{
+		counting = false;
+		return allocations.load(std::memory_order_relaxed);
+	}
+}
+
+extern "C" void* malloc(size_t size)
+{
+	AllocCounter::count(size, __builtin_return_address(0));
+	return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+	AllocCounter::count(count * size, __builtin_return_address(0));
+	return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+	AllocCounter::count(size, __builtin_return_address(0));
+	return __libc_realloc(ptr, size);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size)
+{
+	AllocCounter::count(size, __builtin_return_address(0));
+	return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+	AllocCounter::count(size, __builtin_return_address(0));
+	*ptr = __libc_memalign(alignment, size);
+	return *ptr ? 0 : ENOMEM;
+}
+
+extern "C" void free(void* ptr)
+{
+	//Freeing in steady state means something got allocated and thrown away
+	if (ptr)
+	{
+		AllocCounter::count(0, __builtin_return_address(0));
+	}
+	__libc_free(ptr);
+}
@@ -0,0 +1,33 @@
+#!/bin/sh
+#Checks that SLSsteam's hooks stop allocating once warmed up. First the mock Steam drives every hook
+#through SLSsteam.so and records the calls, then slsreplay replays that recording against Policy.
+#Exits with 3 when either of them allocated
+set -e
+
+cd "$(dirname "$0")/../.."
+
+tmp="$(mktemp -d)"
+trap 'rm -rf "$tmp"' EXIT
+
+mkdir -p "$tmp/SLSsteam"
+cp tools/mock/alloccheck.yaml "$tmp/SLSsteam/config.yaml"
+
+#HOME too, so SLSsteam's log ends up in here instead of next to your real one
+echo "Hooks:"
+status=0
+HOME="$tmp" XDG_CONFIG_HOME="$tmp" bin/mock/steam -n 20000 -a "$PWD/bin/SLSsteam.so" "$@" || status=$?
+if [ "$status" -ne 0 ]; then
+	echo
+	echo "Last lines of SLSsteam's log:"
+	tail -n 20 "$tmp/.SLSsteam.log"
+	exit "$status"
+fi
+
+#Replay decisions may differ from what got recorded, only allocations fail the check
+echo
+echo "Replay:"
+status=0
+bin/slsreplay -a -c "$tmp/SLSsteam/config.yaml" "$tmp/SLSsteam/hooks.slsrec" || status=$?
+if [ "$status" -ne 0 ] && [ "$status" -ne 2 ]; then
+	exit "$status"
+fi
@@ -0,0 +1,16 @@
+#!/bin/sh
+#Runs the mock Steam once without and once with SLSsteam and prints the per call overhead of our hooks.
+#Uses its own config directory, so your config.yaml does not skew the results
+set -e
+
+cd "$(dirname "$0")/../.."
+
+tmp="$(mktemp -d)"
+trap 'rm -rf "$tmp"' EXIT
+
+echo "Without SLSsteam:"
+bin/mock/steam "$@" -o "$tmp/baseline.txt"
+
+echo
+echo "With SLSsteam:"
+XDG_CONFIG_HOME="$tmp" LD_AUDIT="$PWD/bin/SLSsteam.so" bin/mock/steam "$@" -b "$tmp/baseline.txt"
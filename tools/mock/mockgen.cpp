@@ -0,0 +1,125 @@
+//Generates the code of bin/mock/steamclient.so every pattern in patterns.hpp has to match.
+//Writes GNU assembler to stdout, the functions behind it live in tools/mock/steamclient.cpp
+
+#include "patterns.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+enum class SiteType
+{
+	Call, //Pattern starts with a call to symbol, which jumps to the C++ implementation
+	MidFunction, //Pattern lies inside symbol
+	SteamId //Like Call, but symbol is written out here so its tail can be relocated into a stub
+};
+
+///Summary:
+///How the mock has to look for site's pattern to match and be followed the way hooks.cpp does
+static SiteType getSiteType(const Patterns::CSite& site)
+{
+	if (site.followMode == MemHlp::SigFollowMode::PrologueUpwards)
+	{
+		return SiteType::MidFunction;
+	}
+
+	//The only one whose tail gets relocated into a stub instead of being detoured
+	return strcmp(site.name, "IClientUser::GetSteamId") == 0 ? SiteType::SteamId : SiteType::Call;
+}
+
+///Summary:
+///SLSMock_ followed by the site name with :: replaced, e.g. SLSMock_IClientApps_PipeLoop
+static std::string getSymbol(const Patterns::CSite& site)
+{
+	std::string symbol = std::string("SLSMock_").append(site.name);
+	for(size_t pos = symbol.find("::"); pos != std::string::npos; pos = symbol.find("::", pos))
+	{
+		symbol.replace(pos, 2, "_");
+	}
+
+	return symbol;
+}
+
+///Summary:
+///Emits the bytes of pattern starting at token skip. Wildcards become 0
+static void emitBytes(const char* pattern, unsigned int skip)
+{
+	char* copy = strdup(pattern);
+	unsigned int index = 0;
+	bool first = true;
+	for(char* token = strtok(copy, " "); token; token = strtok(nullptr, " "), index++)
+	{
+		if (index < skip)
+			continue;
+
+		printf("%s0x%02x", first ? "\t.byte " : ",", token[0] == '?' ? 0 : static_cast<unsigned int>(strtoul(token, nullptr, 16)));
+		first = false;
+	}
+	printf("\n");
+
+	free(copy);
+}
+
+static void beginFunction(const char* symbol)
+{
+	printf("\n\t.globl %s\n\t.type %s, @function\n\t.p2align 4\n%s:\n.L%s:\n\t.cfi_startproc\n", symbol, symbol, symbol, symbol);
+}
+
+static void endFunction(const char* symbol)
+{
+	printf("\t.cfi_endproc\n\t.size %s, .-%s\n", symbol, symbol);
+}
+
+int main()
+{
+	printf("#Generated by mockgen from patterns.hpp, do not edit\n");
+	printf("\t.text\n");
+
+	for(auto& site : Patterns::sites)
+	{
+		const std::string symbolStr = getSymbol(site);
+		const char* symbol = symbolStr.c_str();
+		printf("\n#%s\n", site.name);
+
+		switch(getSiteType(site))
+		{
+			case SiteType::Call:
+				//Long enough to detour, with a jmp the trampoline has to relocate
+				beginFunction(symbol);
+				printf("\tpushl %%ebp\n\tmovl %%esp, %%ebp\n\tpopl %%ebp\n\tjmp mockImpl_%s\n", symbol + strlen("SLSMock_"));
+				endFunction(symbol);
+				break;
+
+			case SiteType::SteamId:
+				//void(uint32_t* pSteamId). The SteamId is in ecx when the final instructions run
+				beginFunction(symbol);
+				printf("\tmovl 4(%%esp), %%eax\n\tmovl $0x0badf00d, %%ecx\n\tmovl %%ecx, (%%eax)\n\tmovl $0x01100001, 4(%%eax)\n\tret\n");
+				endFunction(symbol);
+				break;
+
+			case SiteType::MidFunction:
+				//Prologue findPrologue looks for, never executes the pattern
+				beginFunction(symbol);
+				printf("\tpushl %%ebp\n\tmovl %%esp, %%ebp\n\tpushl %%edi\n\tpushl %%esi\n\tjmp 1f\n");
+				emitBytes(site.pattern, 0);
+				printf("\t.byte 0,0,0,0\n1:\n\tpopl %%esi\n\tpopl %%edi\n\tpopl %%ebp\n\tret\n");
+				endFunction(symbol);
+				continue;
+		}
+
+		//Call site, only ever scanned. Going through the local label keeps the call direct
+		if (strncmp(site.pattern, "E8 ? ? ? ? ", strlen("E8 ? ? ? ? ")) != 0)
+		{
+			fprintf(stderr, "%s does not start with a relative call!\n", site.name);
+			return 1;
+		}
+
+		printf("\t.p2align 4\n\tint3\n\tcall .L%s\n", symbol);
+		emitBytes(site.pattern, 5);
+		printf("\tint3\n");
+	}
+
+	printf("\n\t.section .note.GNU-stack,\"\",@progbits\n");
+	return 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//vtable layouts as in vftableinfo.hpp. Named like Steam's, so RTTI lookups work the same way
+class IClientApps
+{
+public:
+	virtual void unknown0() = 0;
+	virtual void unknown1() = 0;
+	virtual void unknown2() = 0;
+	virtual void unknown3() = 0;
+	virtual void unknown4() = 0;
+	virtual void unknown5() = 0;
+	virtual void unknown6() = 0;
+	virtual void unknown7() = 0;
+	virtual unsigned int GetDLCCount(uint32_t appId) = 0;
+	virtual bool GetDLCDataByIndex(uint32_t appId, int dlcIndex, uint32_t* pDlcId, bool* pIsAvailable, char* pChDlcName, size_t dlcNameLen) = 0;
+	virtual unsigned int GetAppType(uint32_t appId) = 0;
+};
+
+class IClientAppManager
+{
+public:
+	virtual void InstallApp() = 0;
+	virtual void UninstallApp() = 0;
+	virtual void* LaunchApp(uint32_t* pAppId, void* a2, void* a3, void* a4) = 0;
+	virtual void unknown3() = 0;
+	virtual int GetAppInstallState(uint32_t appId) = 0;
+	virtual void unknown5() = 0;
+	virtual void unknown6() = 0;
+	virtual void unknown7() = 0;
+	virtual void unknown8() = 0;
+	virtual bool IsAppDlcInstalled(uint32_t appId, uint32_t dlcId) = 0;
+	virtual void unknown10() = 0;
+	virtual bool BIsDlcEnabled(uint32_t appId, uint32_t dlcId, void* a3) = 0;
+};
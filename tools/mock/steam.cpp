@@ -0,0 +1,377 @@
+//Driver for bin/mock/steamclient.so. Named steam, since SLSsteam only loads into processes called that.
+//Run it once plain and once with LD_AUDIT set to SLSsteam.so to see what our hooks cost per call.
+//With -a it loads SLSsteam.so itself and fails if any hooked call still allocates after warm-up
+
+#include "../alloccounter.hpp"
+#include "mockinterfaces.hpp"
+
+#include "sdk/CAppOwnershipInfo.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <limits.h>
+#include <link.h>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+typedef void(*LogSteamPipeCall_t)(const char*, const char*);
+typedef bool(*CheckAppOwnership_t)(void*, uint32_t, CAppOwnershipInfo*);
+typedef bool(*BIsSubscribedApp_t)(void*, uint32_t);
+typedef uint32_t(*GetSubscribedApps_t)(void*, uint32_t*, size_t, bool);
+typedef void(*GetSteamId_t)(uint32_t*);
+typedef void(*PipeLoop_t)(void*, void*, void*, void*);
+typedef void*(*GetInterface_t)();
+
+typedef unsigned int(*la_version_t)(unsigned int);
+typedef void(*la_preinit_t)(uintptr_t*);
+typedef unsigned int(*la_objopen_t)(link_map*, Lmid_t, uintptr_t*);
+typedef unsigned int(*la_objclose_t)(uintptr_t*);
+
+//Cycling through a few AppIds keeps SLSsteam's log once cache from growing during the run
+constexpr uint32_t APP_ID_COUNT = 64;
+constexpr uint32_t FIRST_APP_ID = 10;
+
+class CResult
+{
+public:
+	std::string name;
+	bool hooked;
+	double nsPerCall;
+	uint64_t allocations;
+};
+
+template<typename Fn>
+static double measure(unsigned int iterations, Fn fn)
+{
+	//Warm up, SLSsteam does extra work on the first call for each AppId
+	for(unsigned int i = 0; i < APP_ID_COUNT * 4; i++)
+	{
+		fn(FIRST_APP_ID + i % APP_ID_COUNT);
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	for(unsigned int i = 0; i < iterations; i++)
+	{
+		fn(FIRST_APP_ID + i % APP_ID_COUNT);
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+///Summary:
+///Calls fn like measure() does after its warm-up and returns how often that allocated or freed
+template<typename Fn>
+static uint64_t countAllocations(Fn fn)
+{
+	const uint64_t before = AllocCounter::stop();
+
+	AllocCounter::start();
+	for(unsigned int i = 0; i < APP_ID_COUNT * 4; i++)
+	{
+		fn(FIRST_APP_ID + i % APP_ID_COUNT);
+	}
+	return AllocCounter::stop() - before;
+}
+
+static bool isDetoured(void* fn)
+{
+	return *reinterpret_cast<const uint8_t*>(fn) == 0xE9;
+}
+
+static void* getSymbol(void* handle, const char* name)
+{
+	void* symbol = dlsym(handle, name);
+	if (!symbol)
+	{
+		fprintf(stderr, "Missing %s in mock steamclient.so!\n", name);
+		exit(1);
+	}
+
+	return symbol;
+}
+
+///Summary:
+///Stands in for ld.so calling SLSsteam's LD_AUDIT callbacks. Audit modules get a libc of their own
+///in a separate namespace, so loading it like this is the only way our malloc sees its allocations
+static void* loadSLSsteam(const char* path)
+{
+	void* handle = dlopen(path, RTLD_NOW);
+	if (!handle)
+	{
+		fprintf(stderr, "Unable to load %s: %s\n", path, dlerror());
+		return nullptr;
+	}
+
+	//setup() appends to it and assumes it is set, like it always is in Steam
+	setenv("LD_LIBRARY_PATH", getenv("LD_LIBRARY_PATH") ? getenv("LD_LIBRARY_PATH") : "", false);
+
+	if (!reinterpret_cast<la_version_t>(getSymbol(handle, "la_version"))(LAV_CURRENT))
+	{
+		fprintf(stderr, "%s refused to load, is this executable still called steam?\n", path);
+		return nullptr;
+	}
+
+	reinterpret_cast<la_preinit_t>(getSymbol(handle, "la_preinit"))(nullptr);
+	return handle;
+}
+
+static std::map<std::string, double> readBaseline(const char* path)
+{
+	auto baseline = std::map<std::string, double>();
+
+	FILE* file = fopen(path, "r");
+	if (!file)
+	{
+		fprintf(stderr, "Unable to open baseline %s!\n", path);
+		return baseline;
+	}
+
+	char name[128];
+	double ns;
+	while(fscanf(file, "%127s %lf", name, &ns) == 2)
+	{
+		baseline[name] = ns;
+	}
+
+	fclose(file);
+	return baseline;
+}
+
+static void usage(const char* exe)
+{
+	printf("Usage: %s [-n iterations] [-o results] [-b baseline] [-a SLSsteam.so]\n", exe);
+	printf("  -n  Calls per function (default: 1000000)\n");
+	printf("  -o  Write ns per call of every function to this file\n");
+	printf("  -b  Results of a previous run to compare against, usually one without SLSsteam\n");
+	printf("  -a  Load this SLSsteam.so instead of using LD_AUDIT and exit with 3 if hooked calls allocate after warm-up\n");
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int iterations = 1000000;
+	const char* outPath = nullptr;
+	const char* baselinePath = nullptr;
+	const char* slsPath = nullptr;
+
+	int opt;
+	while((opt = getopt(argc, argv, "n:o:b:a:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n':
+				iterations = strtoul(optarg, nullptr, 10);
+				if (!iterations)
+					iterations = 1;
+				break;
+
+			case 'o':
+				outPath = optarg;
+				break;
+
+			case 'b':
+				baselinePath = optarg;
+				break;
+
+			case 'a':
+				slsPath = optarg;
+				break;
+
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	//steamclient.so next to us, the path has to end in /steamclient.so for SLSsteam to pick it up
+	char exe[PATH_MAX];
+	const ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	if (len <= 0)
+	{
+		fprintf(stderr, "Unable to find own path!\n");
+		return 1;
+	}
+	exe[len] = 0;
+
+	std::string path = exe;
+	path = path.substr(0, path.rfind('/')).append("/steamclient.so");
+
+	void* sls = nullptr;
+	if (slsPath)
+	{
+		sls = loadSLSsteam(slsPath);
+		if (!sls)
+			return 1;
+	}
+
+	void* handle = dlopen(path.c_str(), RTLD_NOW);
+	if (!handle)
+	{
+		fprintf(stderr, "Unable to load %s: %s\n", path.c_str(), dlerror());
+		return 1;
+	}
+
+	uintptr_t cookie = 0;
+	if (sls)
+	{
+		link_map* map;
+		dlinfo(handle, RTLD_DI_LINKMAP, &map);
+		reinterpret_cast<la_objopen_t>(getSymbol(sls, "la_objopen"))(map, LM_ID_BASE, &cookie);
+	}
+
+	auto logSteamPipeCall = reinterpret_cast<LogSteamPipeCall_t>(getSymbol(handle, "SLSMock_LogSteamPipeCall"));
+	auto checkAppOwnership = reinterpret_cast<CheckAppOwnership_t>(getSymbol(handle, "SLSMock_CheckAppOwnership"));
+	auto isSubscribedApp = reinterpret_cast<BIsSubscribedApp_t>(getSymbol(handle, "SLSMock_IClientUser_BIsSubscribedApp"));
+	auto getSubscribedApps = reinterpret_cast<GetSubscribedApps_t>(getSymbol(handle, "SLSMock_IClientUser_GetSubscribedApps"));
+	auto getSteamId = reinterpret_cast<GetSteamId_t>(getSymbol(handle, "SLSMock_IClientUser_GetSteamId"));
+	auto appsPipeLoop = reinterpret_cast<PipeLoop_t>(getSymbol(handle, "SLSMock_IClientApps_PipeLoop"));
+	auto appManagerPipeLoop = reinterpret_cast<PipeLoop_t>(getSymbol(handle, "SLSMock_IClientAppManager_PipeLoop"));
+
+	IClientApps* apps = reinterpret_cast<IClientApps*>(reinterpret_cast<GetInterface_t>(getSymbol(handle, "SLSMock_GetClientApps"))());
+	IClientAppManager* appManager = reinterpret_cast<IClientAppManager*>(reinterpret_cast<GetInterface_t>(getSymbol(handle, "SLSMock_GetClientAppManager"))());
+
+	//Otherwise there would be nothing to check
+	if (sls && !isDetoured(reinterpret_cast<void*>(checkAppOwnership)))
+	{
+		fprintf(stderr, "SLSsteam did not place its hooks, check its log!\n");
+		return 1;
+	}
+
+	//First IPC calls like Steam would make them, lets SLSsteam find the interfaces
+	appsPipeLoop(apps, nullptr, nullptr, nullptr);
+	appManagerPipeLoop(appManager, nullptr, nullptr, nullptr);
+
+	void* user = nullptr;
+	auto results = std::vector<CResult>();
+	auto run = [&](const char* name, bool hooked, auto fn)
+	{
+		const double nsPerCall = measure(iterations, fn);
+		results.emplace_back(CResult { name, hooked, nsPerCall, sls ? countAllocations(fn) : 0 });
+	};
+
+	run("LogSteamPipeCall", isDetoured(reinterpret_cast<void*>(logSteamPipeCall)), [&](uint32_t)
+	{
+		logSteamPipeCall("IClientUser", "BIsSubscribedApp");
+	});
+
+	run("CheckAppOwnership", isDetoured(reinterpret_cast<void*>(checkAppOwnership)), [&](uint32_t appId)
+	{
+		CAppOwnershipInfo info {};
+		checkAppOwnership(nullptr, appId, &info);
+	});
+
+	run("IClientUser::BIsSubscribedApp", isDetoured(reinterpret_cast<void*>(isSubscribedApp)), [&](uint32_t appId)
+	{
+		isSubscribedApp(user, appId);
+	});
+
+	run("IClientUser::GetSubscribedApps", isDetoured(reinterpret_cast<void*>(getSubscribedApps)), [&](uint32_t)
+	{
+		uint32_t list[64];
+		getSubscribedApps(user, list, 32, false);
+	});
+
+	run("IClientUser::GetSteamId", false, [&](uint32_t)
+	{
+		uint32_t steamId[2];
+		getSteamId(steamId);
+	});
+
+	run("IClientApps::GetDLCCount", false, [&](uint32_t appId)
+	{
+		apps->GetDLCCount(appId);
+	});
+
+	run("IClientApps::GetDLCDataByIndex", false, [&](uint32_t appId)
+	{
+		uint32_t dlcId;
+		bool available;
+		char name[64];
+		apps->GetDLCDataByIndex(appId, 0, &dlcId, &available, name, sizeof(name));
+	});
+
+	run("IClientAppManager::BIsDlcEnabled", false, [&](uint32_t appId)
+	{
+		appManager->BIsDlcEnabled(appId, appId + 1, nullptr);
+	});
+
+	run("IClientAppManager::IsAppDlcInstalled", false, [&](uint32_t appId)
+	{
+		appManager->IsAppDlcInstalled(appId, appId + 1);
+	});
+
+	const auto baseline = baselinePath ? readBaseline(baselinePath) : std::map<std::string, double>();
+
+	printf("%-38s %-8s %10s %14s %10s %8s\n", "Function", "Detoured", "ns/call", "calls/s", "Overhead", "Allocs");
+	for(auto& result : results)
+	{
+		char overhead[32] = "-";
+		if (baseline.contains(result.name))
+		{
+			snprintf(overhead, sizeof(overhead), "%+.1fns", result.nsPerCall - baseline.at(result.name));
+		}
+
+		char allocations[32] = "-";
+		if (sls)
+		{
+			snprintf(allocations, sizeof(allocations), "%llu", static_cast<unsigned long long>(result.allocations));
+		}
+
+		printf
+		(
+			"%-38s %-8s %10.1f %14.0f %10s %8s\n",
+			result.name.c_str(),
+			result.hooked ? "yes" : "no",
+			result.nsPerCall,
+			1e9 / result.nsPerCall,
+			overhead,
+			allocations
+		);
+	}
+
+	if (outPath)
+	{
+		FILE* file = fopen(outPath, "w");
+		if (!file)
+		{
+			fprintf(stderr, "Unable to write %s!\n", outPath);
+			return 1;
+		}
+
+		for(auto& result : results)
+		{
+			fprintf(file, "%s %f\n", result.name.c_str(), result.nsPerCall);
+		}
+		fclose(file);
+	}
+
+	if (!sls)
+	{
+		return 0;
+	}
+
+	//Like Steam exiting, writes the recording and final stats
+	reinterpret_cast<la_objclose_t>(getSymbol(sls, "la_objclose"))(&cookie);
+
+	for(auto& result : results)
+	{
+		if (result.allocations)
+		{
+			printf
+			(
+				"\n%s allocated after warm-up! First allocation of %u bytes from %p\n",
+				result.name.c_str(),
+				static_cast<unsigned int>(AllocCounter::firstSize.load(std::memory_order_relaxed)),
+				AllocCounter::firstCaller.load(std::memory_order_relaxed)
+			);
+			return 3;
+		}
+	}
+
+	printf("\nNo allocations after warm-up\n");
+	return 0;
+}
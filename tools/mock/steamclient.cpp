@@ -0,0 +1,149 @@
+//Stand-in for steamclient.so, so Hooks::setup and Hooks::place can run without Steam.
+//The exported SLSMock_* functions and the call sites matching patterns.hpp get generated by mockgen,
+//they jump to the mockImpl_* functions below
+
+#include "mockinterfaces.hpp"
+
+#include "sdk/CAppOwnershipInfo.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#define MOCK_IMPL extern "C" __attribute__((visibility("hidden"), used, noinline))
+#define MOCK_EXPORT extern "C" __attribute__((visibility("default")))
+
+//Keeps the compiler from optimizing the mocks into nothing
+static volatile uint32_t sink;
+
+MOCK_IMPL void mockImpl_LogSteamPipeCall(const char* iface, const char* fn)
+{
+	sink = sink + (iface[0] ^ fn[0]);
+}
+
+MOCK_IMPL bool mockImpl_CheckAppOwnership(void*, uint32_t appId, CAppOwnershipInfo* pOwnershipInfo)
+{
+	const bool owned = appId % 2 == 0;
+	pOwnershipInfo->purchased = owned;
+	pOwnershipInfo->permanent = owned;
+	pOwnershipInfo->familyShared = false;
+	pOwnershipInfo->ownerSteamId = owned ? 0x0badf00d : 0;
+	return true;
+}
+
+MOCK_IMPL void mockImpl_RunningApp()
+{
+	sink = sink + 1;
+}
+
+MOCK_IMPL bool mockImpl_IClientUser_BIsSubscribedApp(void*, uint32_t appId)
+{
+	return appId % 2 == 0;
+}
+
+MOCK_IMPL uint32_t mockImpl_IClientUser_GetSubscribedApps(void*, uint32_t* pAppList, size_t size, bool)
+{
+	constexpr uint32_t count = 16;
+	for(uint32_t i = 0; pAppList && i < count && i < size; i++)
+	{
+		pAppList[i] = (i + 1) * 10;
+	}
+
+	return count;
+}
+
+//Steam dispatches IPC calls to interfaces in these, we only see the interface getting passed in
+MOCK_IMPL void mockImpl_IClientAppManager_PipeLoop(void* pClientAppManager, void*, void*, void*)
+{
+	sink = sink + reinterpret_cast<uintptr_t>(pClientAppManager);
+}
+
+MOCK_IMPL void mockImpl_IClientApps_PipeLoop(void* pClientApps, void*, void*, void*)
+{
+	sink = sink + reinterpret_cast<uintptr_t>(pClientApps);
+}
+
+MOCK_IMPL void mockImpl_IClientUser_PipeLoop(void* pClientUser, void*, void*, void*)
+{
+	sink = sink + reinterpret_cast<uintptr_t>(pClientUser);
+}
+
+class CClientApps : public IClientApps
+{
+public:
+	virtual void unknown0() {}
+	virtual void unknown1() {}
+	virtual void unknown2() {}
+	virtual void unknown3() {}
+	virtual void unknown4() {}
+	virtual void unknown5() {}
+	virtual void unknown6() {}
+	virtual void unknown7() {}
+
+	virtual unsigned int GetDLCCount(uint32_t appId)
+	{
+		return appId % 4;
+	}
+
+	virtual bool GetDLCDataByIndex(uint32_t appId, int dlcIndex, uint32_t* pDlcId, bool* pIsAvailable, char* pChDlcName, size_t dlcNameLen)
+	{
+		*pDlcId = appId + dlcIndex + 1;
+		*pIsAvailable = dlcIndex % 2 == 0;
+		snprintf(pChDlcName, dlcNameLen, "Dlc %u", *pDlcId);
+		return true;
+	}
+
+	virtual unsigned int GetAppType(uint32_t)
+	{
+		return 1; //APPTYPE_GAME
+	}
+};
+
+class CClientAppManager : public IClientAppManager
+{
+public:
+	virtual void InstallApp() {}
+	virtual void UninstallApp() {}
+
+	virtual void* LaunchApp(uint32_t*, void*, void*, void*)
+	{
+		return nullptr;
+	}
+
+	virtual void unknown3() {}
+
+	virtual int GetAppInstallState(uint32_t)
+	{
+		return 4; //APPSTATE_INSTALLED
+	}
+
+	virtual void unknown5() {}
+	virtual void unknown6() {}
+	virtual void unknown7() {}
+	virtual void unknown8() {}
+
+	virtual bool IsAppDlcInstalled(uint32_t, uint32_t dlcId)
+	{
+		return dlcId % 2 == 0;
+	}
+
+	virtual void unknown10() {}
+
+	virtual bool BIsDlcEnabled(uint32_t, uint32_t dlcId, void*)
+	{
+		return dlcId % 2 == 0;
+	}
+};
+
+static CClientApps clientApps;
+static CClientAppManager clientAppManager;
+
+MOCK_EXPORT IClientApps* SLSMock_GetClientApps()
+{
+	return &clientApps;
+}
+
+MOCK_EXPORT IClientAppManager* SLSMock_GetClientAppManager()
+{
+	return &clientAppManager;
+}
@@ -0,0 +1,525 @@
+//Microbenchmarks for the parts of SLSsteam which run on every hook call or during startup.
+//Results get written as JSON, so runs of different commits can be compared with -b
+
+#include "config.hpp"
+#include "log.hpp"
+#include "memhlp.hpp"
+#include "patterns.hpp"
+#include "utils.hpp"
+
+#include "libmem/libmem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+class CBenchmark
+{
+public:
+	std::string name;
+	//Bytes processed per iteration, for throughput of scanners and hashing. 0 if it does not apply
+	uint64_t bytes;
+	std::function<void(uint64_t iterations)> run;
+};
+
+class CResult
+{
+public:
+	std::string name;
+	uint64_t iterations;
+	double nsPerOp;
+	double mibPerSec;
+};
+
+//Keeps the compiler from dropping calls whose results we do not need
+static volatile uintptr_t sink;
+
+static const char* logPath = "/dev/null";
+static std::string tmpDir;
+
+static uint32_t xorshift(uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+static void resetLog()
+{
+	//Fresh log for every benchmark, otherwise once's cache depends on what ran before
+	g_pLog = std::make_unique<CLog>(logPath);
+}
+
+static void addLogBenchmarks(std::vector<CBenchmark>& benchmarks)
+{
+	benchmarks.emplace_back(CBenchmark { "log/debug", 0, [](uint64_t iterations)
+	{
+		for(uint64_t i = 0; i < iterations; i++)
+		{
+			g_pLog->debug("IClientUser::BIsSubscribedApp(%p, %u) -> %i\n", nullptr, static_cast<uint32_t>(i), 1);
+		}
+	}});
+
+	//once only prints the first time, so these measure the lookup in its message cache
+	for(const unsigned int cached : { 64u, 4096u })
+	{
+		benchmarks.emplace_back(CBenchmark { "log/once_" + std::to_string(cached), 0, [cached](uint64_t iterations)
+		{
+			for(unsigned int i = 0; i < cached; i++)
+			{
+				g_pLog->once("shouldExcludeAppId(%u) -> %i\n", i, 0);
+			}
+
+			for(uint64_t i = 0; i < iterations; i++)
+			{
+				g_pLog->once("shouldExcludeAppId(%u) -> %i\n", static_cast<uint32_t>(i % cached), 0);
+			}
+		}});
+	}
+}
+
+static void addConfigBenchmarks(std::vector<CBenchmark>& benchmarks)
+{
+	for(const uint32_t count : { 10u, 10000u, 1000000u })
+	{
+		benchmarks.emplace_back(CBenchmark { "config/shouldExcludeAppId_" + std::to_string(count), 0, [count](uint64_t iterations)
+		{
+			auto config = std::make_unique<CConfig>();
+			config->useWhiteList = false;
+			for(uint32_t i = 0; i < count; i++)
+			{
+				config->appIds.emplace(i * 10);
+			}
+
+			//Steam asks for the same few hundred AppIds over and over, half of them are in our list here
+			uint32_t state = 1;
+			for(uint64_t i = 0; i < iterations; i++)
+			{
+				const uint32_t appId = (i % 256) * 5 % (count * 10);
+				sink = config->shouldExcludeAppId(appId) ^ xorshift(state);
+			}
+		}});
+	}
+
+	for(const unsigned int dlcs : { 8u, 64u, 1024u })
+	{
+		benchmarks.emplace_back(CBenchmark { "config/getDlcByIndex_" + std::to_string(dlcs), 0, [dlcs](uint64_t iterations)
+		{
+			auto config = std::make_unique<CConfig>();
+			for(uint32_t app = 0; app < 16; app++)
+			{
+				auto& data = config->dlcData.emplace(app, CConfig::CDlcData()).first->second;
+				data.parentId = app;
+				for(unsigned int dlc = 0; dlc < dlcs; dlc++)
+				{
+					data.dlcIds[app * 100000 + dlc] = ("DLC " + std::to_string(dlc)).c_str();
+				}
+			}
+
+			//Steam walks every index after asking for the count
+			for(uint64_t i = 0; i < iterations; i++)
+			{
+				const auto dlc = config->getDlcByIndex(i % 16, i % dlcs);
+				sink = reinterpret_cast<uintptr_t>(dlc);
+			}
+		}});
+	}
+}
+
+///Summary:
+///Writes config.yaml into tmpDir, with appIds entries in AppIds and AdditionalApps
+///and dlcApps apps with 64 DLCs each in DlcData
+static bool writeConfig(unsigned int appIds, unsigned int dlcApps)
+{
+	setenv("XDG_CONFIG_HOME", tmpDir.c_str(), 1);
+
+	//Start from the default config so every option is present and getSetting does not notify
+	CConfig config;
+	const std::string path = config.getPath();
+	std::remove(path.c_str());
+	if (!config.createFile())
+	{
+		return false;
+	}
+
+	std::ifstream in(path);
+	std::stringstream ss;
+	ss << in.rdbuf();
+	std::string yaml = ss.str();
+
+	std::string list;
+	for(unsigned int i = 0; i < appIds; i++)
+	{
+		list.append("  - ").append(std::to_string(i * 10)).append("\n");
+	}
+
+	std::string additional;
+	for(unsigned int i = 0; i < appIds; i++)
+	{
+		additional.append("  - ").append(std::to_string(i * 10 + 5)).append("\n");
+	}
+
+	std::string dlcs;
+	for(unsigned int app = 0; app < dlcApps; app++)
+	{
+		dlcs.append("  ").append(std::to_string(app * 10)).append(":\n");
+		for(unsigned int dlc = 0; dlc < 64; dlc++)
+		{
+			dlcs.append("    ").append(std::to_string(app * 100000 + dlc)).append(": \"DLC ").append(std::to_string(dlc)).append("\"\n");
+		}
+	}
+
+	//Lists are empty in the default config, the commented out examples start with # instead of a newline
+	for(const auto& [key, entries] : { std::make_pair("\nAppIds:\n", &list), std::make_pair("\nAdditionalApps:\n", &additional), std::make_pair("\nDlcData:\n", &dlcs) })
+	{
+		const size_t pos = yaml.find(key);
+		if (pos == std::string::npos)
+		{
+			return false;
+		}
+
+		yaml.insert(pos + strlen(key), *entries);
+	}
+
+	std::ofstream out(path, std::ios::trunc);
+	out << yaml;
+	return out.good();
+}
+
+static void addLoadSettingsBenchmarks(std::vector<CBenchmark>& benchmarks)
+{
+	for(const auto& [name, appIds, dlcApps] : { std::make_tuple("small", 10u, 1u), std::make_tuple("large", 10000u, 200u) })
+	{
+		benchmarks.emplace_back(CBenchmark { std::string("config/loadSettings_") + name, 0, [appIds, dlcApps](uint64_t iterations)
+		{
+			//Rewritten every run since calibrating calls us more than once
+			if (!writeConfig(appIds, dlcApps))
+			{
+				fprintf(stderr, "Unable to write config to %s!\n", tmpDir.c_str());
+				exit(1);
+			}
+
+			for(uint64_t i = 0; i < iterations; i++)
+			{
+				auto config = std::make_unique<CConfig>();
+				config->loadSettings();
+				sink = config->appIds.size();
+			}
+		}});
+	}
+}
+
+static void addScanBenchmarks(std::vector<CBenchmark>& benchmarks)
+{
+	//Random bytes with every pattern placed at the end, so each scan has to walk the whole image
+	constexpr size_t imageSize = 16 * 1024 * 1024;
+	static std::vector<lm_byte_t> image;
+
+	if (image.empty())
+	{
+		image.resize(imageSize);
+
+		uint32_t state = 0x534C53;
+		for(auto& byte : image)
+		{
+			byte = static_cast<lm_byte_t>(xorshift(state));
+		}
+
+		size_t offset = imageSize;
+		for(auto& site : Patterns::sites)
+		{
+			const MemHlp::CSignature sig(site.pattern);
+			offset -= sig.bytes.size() + 16;
+			for(size_t i = 0; i < sig.bytes.size(); i++)
+			{
+				image[offset + i] = sig.mask[i] == 'x' ? sig.bytes[i] : 0;
+			}
+		}
+	}
+
+	const uint64_t bytesPerSet = imageSize * std::size(Patterns::sites);
+
+	benchmarks.emplace_back(CBenchmark { "scan/libmem", bytesPerSet, [](uint64_t iterations)
+	{
+		for(uint64_t i = 0; i < iterations; i++)
+		{
+			for(auto& site : Patterns::sites)
+			{
+				sink = LM_SigScan(site.pattern, reinterpret_cast<lm_address_t>(image.data()), image.size());
+			}
+		}
+	}});
+
+	benchmarks.emplace_back(CBenchmark { "scan/memhlp", bytesPerSet, [](uint64_t iterations)
+	{
+		for(uint64_t i = 0; i < iterations; i++)
+		{
+			for(auto& site : Patterns::sites)
+			{
+				//Parsing is part of what searchSignature does for every pattern
+				const MemHlp::CSignature sig(site.pattern);
+				sink = sig.scan(reinterpret_cast<lm_address_t>(image.data()), image.size());
+			}
+		}
+	}});
+}
+
+static void addHashBenchmarks(std::vector<CBenchmark>& benchmarks)
+{
+	//Roughly the size of steamclient.so
+	constexpr size_t fileSize = 64 * 1024 * 1024;
+
+	benchmarks.emplace_back(CBenchmark { "utils/getFileSHA256", fileSize, [](uint64_t iterations)
+	{
+		const std::string path = tmpDir + "/steamclient.so";
+		if (access(path.c_str(), F_OK) != 0)
+		{
+			FILE* file = fopen(path.c_str(), "w");
+			if (!file)
+			{
+				fprintf(stderr, "Unable to write %s!\n", path.c_str());
+				exit(1);
+			}
+
+			auto chunk = std::make_unique<uint32_t[]>(1024 * 1024 / sizeof(uint32_t));
+			uint32_t state = 1;
+			for(size_t written = 0; written < fileSize; written += 1024 * 1024)
+			{
+				for(size_t i = 0; i < 1024 * 1024 / sizeof(uint32_t); i++)
+				{
+					chunk[i] = xorshift(state);
+				}
+				fwrite(chunk.get(), 1, 1024 * 1024, file);
+			}
+			fclose(file);
+		}
+
+		for(uint64_t i = 0; i < iterations; i++)
+		{
+			sink = Utils::getFileSHA256(path.c_str()).size();
+		}
+	}});
+}
+
+///Summary:
+///Doubles the iterations until one run takes at least minSeconds, so slow and fast benchmarks
+///both get measured long enough without having to hardcode counts for each of them
+static CResult measure(const CBenchmark& benchmark, double minSeconds)
+{
+	uint64_t iterations = 1;
+	for(;;)
+	{
+		resetLog();
+
+		const auto start = std::chrono::steady_clock::now();
+		benchmark.run(iterations);
+		const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		if (ns >= minSeconds * 1e9 || iterations >= (1ull << 40))
+		{
+			const double nsPerOp = ns / iterations;
+			const double mibPerSec = benchmark.bytes ? benchmark.bytes / 1048576.0 / (nsPerOp / 1e9) : 0;
+			return CResult { benchmark.name, iterations, nsPerOp, mibPerSec };
+		}
+
+		//Jump close to the target once we have a usable estimate
+		if (ns > 1e6)
+		{
+			iterations = std::max(iterations * 2, static_cast<uint64_t>(iterations * minSeconds * 1e9 / ns * 1.1));
+		}
+		else
+		{
+			iterations *= 2;
+		}
+	}
+}
+
+static bool writeJson(const char* path, const char* commit, const std::vector<CResult>& results)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+	{
+		fprintf(stderr, "Unable to write %s!\n", path);
+		return false;
+	}
+
+	//One benchmark per line, readBaseline relies on it. Names are our own, so there's nothing to escape
+	fprintf(file, "{\n\t\"commit\": \"%s\",\n\t\"benchmarks\": [\n", commit);
+	for(size_t i = 0; i < results.size(); i++)
+	{
+		auto& result = results.at(i);
+		fprintf
+		(
+			file,
+			"\t\t{ \"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"mib_per_s\": %.3f }%s\n",
+			result.name.c_str(),
+			static_cast<unsigned long long>(result.iterations),
+			result.nsPerOp,
+			result.mibPerSec,
+			i + 1 < results.size() ? "," : ""
+		);
+	}
+	fprintf(file, "\t]\n}\n");
+
+	fclose(file);
+	return true;
+}
+
+static std::map<std::string, double> readBaseline(const char* path)
+{
+	auto baseline = std::map<std::string, double>();
+
+	FILE* file = fopen(path, "r");
+	if (!file)
+	{
+		fprintf(stderr, "Unable to open baseline %s!\n", path);
+		return baseline;
+	}
+
+	char line[512];
+	while(fgets(line, sizeof(line), file))
+	{
+		char name[128];
+		unsigned long long iterations;
+		double nsPerOp;
+		if (sscanf(line, " { \"name\": \"%127[^\"]\", \"iterations\": %llu, \"ns_per_op\": %lf", name, &iterations, &nsPerOp) == 3)
+		{
+			baseline[name] = nsPerOp;
+		}
+	}
+
+	fclose(file);
+	return baseline;
+}
+
+static void usage(const char* exe)
+{
+	printf("Usage: %s [-f filter] [-t seconds] [-o results.json] [-b baseline.json] [-c commit] [-l logfile]\n", exe);
+	printf("  -f  Only run benchmarks whose name contains filter\n");
+	printf("  -t  Minimum time to measure each benchmark for (default: 0.5)\n");
+	printf("  -o  Write results to this file (default: bench.json)\n");
+	printf("  -b  Results of a previous run to compare against\n");
+	printf("  -c  Commit to note in the results\n");
+	printf("  -l  Write SLSsteam's log to this file instead of discarding it\n");
+}
+
+int main(int argc, char** argv)
+{
+	const char* filter = nullptr;
+	double minSeconds = 0.5;
+	const char* outPath = "bench.json";
+	const char* baselinePath = nullptr;
+	const char* commit = "unknown";
+
+	int opt;
+	while((opt = getopt(argc, argv, "f:t:o:b:c:l:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'f':
+				filter = optarg;
+				break;
+
+			case 't':
+				minSeconds = strtod(optarg, nullptr);
+				if (minSeconds <= 0)
+					minSeconds = 0.5;
+				break;
+
+			case 'o':
+				outPath = optarg;
+				break;
+
+			case 'b':
+				baselinePath = optarg;
+				break;
+
+			case 'c':
+				commit = optarg;
+				break;
+
+			case 'l':
+				logPath = optarg;
+				break;
+
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	char tmpTemplate[] = "/tmp/slsbench-XXXXXX";
+	if (!mkdtemp(tmpTemplate))
+	{
+		fprintf(stderr, "Unable to create temporary directory!\n");
+		return 1;
+	}
+	tmpDir = tmpTemplate;
+
+	auto benchmarks = std::vector<CBenchmark>();
+	addLogBenchmarks(benchmarks);
+	addConfigBenchmarks(benchmarks);
+	addLoadSettingsBenchmarks(benchmarks);
+	addScanBenchmarks(benchmarks);
+	addHashBenchmarks(benchmarks);
+
+	const auto baseline = baselinePath ? readBaseline(baselinePath) : std::map<std::string, double>();
+
+	printf("%-36s %12s %14s %12s %10s\n", "Benchmark", "Iterations", "ns/op", "MiB/s", "Change");
+
+	auto results = std::vector<CResult>();
+	for(auto& benchmark : benchmarks)
+	{
+		if (filter && !strstr(benchmark.name.c_str(), filter))
+			continue;
+
+		const CResult result = measure(benchmark, minSeconds);
+		results.emplace_back(result);
+
+		char change[32] = "-";
+		if (baseline.contains(result.name) && baseline.at(result.name) > 0)
+		{
+			snprintf(change, sizeof(change), "%+.1f%%", (result.nsPerOp / baseline.at(result.name) - 1) * 100);
+		}
+
+		char throughput[32] = "-";
+		if (result.mibPerSec > 0)
+		{
+			snprintf(throughput, sizeof(throughput), "%.1f", result.mibPerSec);
+		}
+
+		printf
+		(
+			"%-36s %12llu %14.1f %12s %10s\n",
+			result.name.c_str(),
+			static_cast<unsigned long long>(result.iterations),
+			result.nsPerOp,
+			throughput,
+			change
+		);
+		fflush(stdout);
+	}
+
+	g_pLog.reset();
+
+	std::string cleanup = tmpDir + "/SLSsteam/config.yaml";
+	std::remove(cleanup.c_str());
+	std::remove((tmpDir + "/SLSsteam").c_str());
+	std::remove((tmpDir + "/steamclient.so").c_str());
+	std::remove(tmpDir.c_str());
+
+	return writeJson(outPath, commit, results) ? 0 : 1;
+}
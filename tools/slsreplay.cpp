@@ -0,0 +1,380 @@
+//Replays a hooks.slsrec recorded with RecordDuration against the host build of Policy.
+//Reports how long each decision takes and every call where we now decide differently than Steam saw.
+//With -a it also fails if replaying allocates anything once every AppId has been seen
+
+#include "alloccounter.hpp"
+#include "config.hpp"
+#include "globals.hpp"
+#include "log.hpp"
+#include "policy.hpp"
+#include "recorder.hpp"
+
+#include "sdk/CAppOwnershipInfo.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+
+class CHookResult
+{
+public:
+	uint64_t calls;
+	uint64_t mismatches;
+	uint64_t undecidable; //Needed an AppType the recording does not have
+	double totalNs;
+	double maxNs;
+};
+
+//Event currently being replayed, for replayGetAppType
+static const Recorder::CEvent* currentEvent;
+static bool missingAppType;
+static std::vector<uint32_t> appList;
+
+static bool replayGetAppType(uint32_t, EAppType& type)
+{
+	//Recorded without asking Steam, either because there was no IClientApps yet
+	//or because the policy back then did not need it. What we decide now can't be compared then
+	if (currentEvent->state == Recorder::STATE_NONE)
+	{
+		missingAppType = true;
+		return false;
+	}
+
+	type = static_cast<EAppType>(currentEvent->state);
+	return true;
+}
+
+static int32_t replay(const Recorder::CEvent& event)
+{
+	currentEvent = &event;
+	missingAppType = false;
+	g_currentSteamId = event.steamId;
+
+	switch(event.hook)
+	{
+		case Recorder::HookId::CheckAppOwnership:
+		{
+			CAppOwnershipInfo info {};
+			info.purchased = event.flags & Recorder::FLAG_PURCHASED;
+			CAppOwnershipInfo* pInfo = event.flags & Recorder::FLAG_OWNERSHIP_INFO ? &info : nullptr;
+
+			return Policy::checkAppOwnership(event.appId, event.original, pInfo, event.steamId, replayGetAppType);
+		}
+		case Recorder::HookId::BIsSubscribedApp:
+			return Policy::isSubscribedApp(event.appId, event.original);
+		case Recorder::HookId::GetSubscribedApps:
+		{
+			if (!(event.flags & Recorder::FLAG_APP_LIST))
+			{
+				return Policy::getSubscribedApps(nullptr, event.arg, event.original);
+			}
+
+			//Steam sized it for the count we told it during the first call
+			const size_t size = event.original + g_config.addedAppIds.size();
+			if (appList.size() < size)
+			{
+				appList.resize(size);
+			}
+			return Policy::getSubscribedApps(appList.data(), event.arg, event.original);
+		}
+		case Recorder::HookId::IsAppDlcInstalled:
+			return Policy::isAppDlcInstalled(event.appId, event.dlcId, event.original, static_cast<EAppState>(event.state));
+		case Recorder::HookId::BIsDlcEnabled:
+			return Policy::isDlcEnabled(event.dlcId, event.original);
+		case Recorder::HookId::GetDLCCount:
+			return Policy::getDlcCount(event.appId, event.original);
+		case Recorder::HookId::GetDLCDataByIndex:
+		{
+			uint32_t dlcId = event.dlcId;
+			const auto dlc = g_config.getDlcByIndex(event.appId, event.arg);
+			if (dlc)
+			{
+				dlcId = dlc->first;
+			}
+
+			return Policy::isDlcAvailable(dlcId, event.original);
+		}
+		case Recorder::HookId::LaunchApp:
+			Policy::onLaunchApp(event.appId);
+			return 0;
+
+		default:
+			return event.decision;
+	}
+}
+
+static bool readRecording(const char* path, Recorder::CHeader& header, std::vector<Recorder::CEvent>& events)
+{
+	FILE* file = fopen(path, "r");
+	if (!file)
+	{
+		fprintf(stderr, "Unable to open %s!\n", path);
+		return false;
+	}
+
+	if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != Recorder::MAGIC)
+	{
+		fprintf(stderr, "%s is not a hook recording!\n", path);
+		fclose(file);
+		return false;
+	}
+
+	if (header.version != Recorder::VERSION || header.eventSize != sizeof(Recorder::CEvent))
+	{
+		fprintf
+		(
+			stderr,
+			"%s has an unsupported format (version %u, event size %u)! Expected version %u, event size %u\n",
+			path,
+			header.version,
+			header.eventSize,
+			Recorder::VERSION,
+			static_cast<unsigned int>(sizeof(Recorder::CEvent))
+		);
+		fclose(file);
+		return false;
+	}
+
+	Recorder::CEvent event;
+	while(fread(&event, sizeof(event), 1, file) == 1)
+	{
+		events.emplace_back(event);
+	}
+
+	fclose(file);
+	return true;
+}
+
+static bool loadConfig(const char* path)
+{
+	//loadSettings only ever adds to the lists, CheckAppOwnership adds to AdditionalApps too
+	g_config.appIds.clear();
+	g_config.addedAppIds.clear();
+	g_config.dlcData.clear();
+
+	return path ? g_config.loadSettings(path) : g_config.loadSettings();
+}
+
+static void usage(const char* exe)
+{
+	printf("Usage: %s [-c config.yaml] [-n loops] [-v] [-a] [-l logfile] <hooks.slsrec>\n", exe);
+	printf("  -c  Config to decide with (default: the one SLSsteam uses)\n");
+	printf("  -n  Replay the recording this many times for steadier timings (default: 1)\n");
+	printf("  -v  Print every call which got decided differently\n");
+	printf("  -a  Replay once more without resetting and fail if that allocates or frees anything\n");
+	printf("  -l  Write SLSsteam's log to this file instead of discarding it\n");
+}
+
+int main(int argc, char** argv)
+{
+	const char* configPath = nullptr;
+	const char* logPath = "/dev/null";
+	unsigned int loops = 1;
+	bool verbose = false;
+	bool checkAllocations = false;
+
+	int opt;
+	while((opt = getopt(argc, argv, "c:n:val:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'c':
+				configPath = optarg;
+				break;
+
+			case 'n':
+				loops = strtoul(optarg, nullptr, 10);
+				if (!loops)
+					loops = 1;
+				break;
+
+			case 'v':
+				verbose = true;
+				break;
+
+			case 'a':
+				checkAllocations = true;
+				break;
+
+			case 'l':
+				logPath = optarg;
+				break;
+
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (optind >= argc)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	g_pLog = std::make_unique<CLog>(logPath);
+
+	Recorder::CHeader header;
+	auto events = std::vector<Recorder::CEvent>();
+	if (!readRecording(argv[optind], header, events))
+	{
+		return 1;
+	}
+
+	const double durationMs = events.empty() ? 0 : (events.back().timestamp - header.start) / 1e6;
+	printf("%s: %u calls recorded in pid %u over %.1fms\n", argv[optind], static_cast<unsigned int>(events.size()), header.pid, durationMs);
+	printf("Replaying %u times\n\n", loops);
+
+	CHookResult results[static_cast<size_t>(Recorder::HookId::Count)] {};
+	for(unsigned int loop = 0; loop < loops; loop++)
+	{
+		Policy::reset();
+		if (!loadConfig(configPath))
+		{
+			fprintf(stderr, "Unable to load config!\n");
+			return 1;
+		}
+
+		for(auto& event : events)
+		{
+			if (event.hook >= Recorder::HookId::Count)
+				continue;
+
+			const auto start = std::chrono::steady_clock::now();
+			const int32_t decision = replay(event);
+			const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+			CHookResult& result = results[static_cast<size_t>(event.hook)];
+			result.calls++;
+			result.totalNs += ns;
+			if (ns > result.maxNs)
+				result.maxNs = ns;
+
+			//Later loops decide the same, no need to report them again
+			if (loop != 0 || event.hook == Recorder::HookId::LaunchApp)
+				continue;
+
+			if (missingAppType)
+			{
+				result.undecidable++;
+				if (verbose)
+				{
+					printf
+					(
+						"%+.3fms %s(%u) tid %u: needs an AppType which was not recorded\n",
+						(event.timestamp - header.start) / 1e6,
+						Recorder::hookIdToStr(event.hook),
+						event.appId,
+						event.tid
+					);
+				}
+			}
+			else if (decision != event.decision)
+			{
+				result.mismatches++;
+				if (verbose)
+				{
+					printf
+					(
+						"%+.3fms %s(%u, %u) tid %u: original %i, recorded %i, now %i\n",
+						(event.timestamp - header.start) / 1e6,
+						Recorder::hookIdToStr(event.hook),
+						event.appId,
+						event.dlcId,
+						event.tid,
+						event.original,
+						event.decision,
+						decision
+					);
+				}
+			}
+		}
+	}
+
+	if (verbose)
+	{
+		printf("\n");
+	}
+
+	if (checkAllocations)
+	{
+		//CheckAppOwnership might have added to AdditionalApps since GetSubscribedApps was replayed last,
+		//our stand-in for Steam's list has to grow beforehand so only SLSsteam's allocations get counted
+		for(auto& event : events)
+		{
+			if (event.hook == Recorder::HookId::GetSubscribedApps && appList.size() < event.original + g_config.addedAppIds.size())
+			{
+				appList.resize(event.original + g_config.addedAppIds.size());
+			}
+		}
+
+		//Previous loops were the warm-up. Without resetting, every AppId and message was seen before
+		//just like in a long running Steam, so nothing should need memory anymore
+		AllocCounter::start();
+		for(auto& event : events)
+		{
+			if (event.hook < Recorder::HookId::Count)
+				replay(event);
+		}
+		AllocCounter::stop();
+	}
+
+	printf("%-40s %10s %10s %12s %10s %10s\n", "Hook", "Calls", "Changed", "Undecidable", "Avg ns", "Max ns");
+
+	uint64_t mismatches = 0, undecidable = 0;
+	for(size_t i = 0; i < static_cast<size_t>(Recorder::HookId::Count); i++)
+	{
+		const CHookResult& result = results[i];
+		if (!result.calls)
+			continue;
+
+		printf
+		(
+			"%-40s %10llu %10llu %12llu %10.1f %10.1f\n",
+			Recorder::hookIdToStr(static_cast<Recorder::HookId>(i)),
+			static_cast<unsigned long long>(result.calls / loops),
+			static_cast<unsigned long long>(result.mismatches),
+			static_cast<unsigned long long>(result.undecidable),
+			result.totalNs / result.calls,
+			result.maxNs
+		);
+		mismatches += result.mismatches;
+		undecidable += result.undecidable;
+	}
+
+	if (undecidable)
+	{
+		printf("\n%llu calls need an AppType the recording does not have, record again to check them\n", static_cast<unsigned long long>(undecidable));
+	}
+
+	if (checkAllocations)
+	{
+		const uint64_t count = AllocCounter::allocations.load(std::memory_order_relaxed);
+		if (count)
+		{
+			printf
+			(
+				"\n%llu allocations after warm-up! First one of %u bytes from %p\n",
+				static_cast<unsigned long long>(count),
+				static_cast<unsigned int>(AllocCounter::firstSize.load(std::memory_order_relaxed)),
+				AllocCounter::firstCaller.load(std::memory_order_relaxed)
+			);
+		}
+		else
+		{
+			printf("\nNo allocations after warm-up\n");
+		}
+	}
+
+	g_pLog.reset();
+
+	if (checkAllocations && AllocCounter::allocations.load(std::memory_order_relaxed))
+	{
+		return 3;
+	}
+	return mismatches ? 2 : 0;
+}
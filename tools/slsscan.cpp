@@ -0,0 +1,230 @@
+//Offline signature scanner. Maps a steamclient.so from disk the same way the dynamic loader would
+//and runs our patterns against it, so we can check them without having to launch Steam
+
+#include "log.hpp"
+#include "memhlp.hpp"
+#include "patterns.hpp"
+
+#include "libmem/libmem.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <link.h>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum class ScanEngine
+{
+	Libmem,
+	MemHlp
+};
+
+static lm_address_t scan(ScanEngine engine, const char* signature, const MemHlp::CSignature& sig, lm_address_t address, lm_size_t size)
+{
+	switch(engine)
+	{
+		case ScanEngine::MemHlp:
+			return sig.scan(address, size);
+
+		default:
+			return LM_SigScan(signature, address, size);
+	}
+}
+
+///Summary:
+///Map every PT_LOAD segment of path at its virtual address, like ld.so does
+static bool mapModule(const char* path, lm_module_t& module)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Unable to open %s!\n", path);
+		return false;
+	}
+
+	ElfW(Ehdr) ehdr;
+	if (pread(fd, &ehdr, sizeof(ehdr), 0) != sizeof(ehdr) || memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0)
+	{
+		fprintf(stderr, "%s is not an ELF file!\n", path);
+		close(fd);
+		return false;
+	}
+
+	if (ehdr.e_ident[EI_CLASS] != (sizeof(void*) == 4 ? ELFCLASS32 : ELFCLASS64))
+	{
+		fprintf(stderr, "%s does not match the bitness of slsscan!\n", path);
+		close(fd);
+		return false;
+	}
+
+	auto phdrs = std::make_unique<ElfW(Phdr)[]>(ehdr.e_phnum);
+	pread(fd, phdrs.get(), sizeof(ElfW(Phdr)) * ehdr.e_phnum, ehdr.e_phoff);
+
+	lm_size_t size = 0;
+	for(unsigned int i = 0; i < ehdr.e_phnum; i++)
+	{
+		if (phdrs[i].p_type == PT_LOAD && phdrs[i].p_vaddr + phdrs[i].p_memsz > size)
+		{
+			size = phdrs[i].p_vaddr + phdrs[i].p_memsz;
+		}
+	}
+
+	void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+	{
+		fprintf(stderr, "Unable to map %u bytes for %s!\n", static_cast<unsigned int>(size), path);
+		close(fd);
+		return false;
+	}
+
+	for(unsigned int i = 0; i < ehdr.e_phnum; i++)
+	{
+		if (phdrs[i].p_type != PT_LOAD)
+			continue;
+
+		pread(fd, reinterpret_cast<lm_byte_t*>(base) + phdrs[i].p_vaddr, phdrs[i].p_filesz, phdrs[i].p_offset);
+	}
+
+	close(fd);
+
+	module.base = reinterpret_cast<lm_address_t>(base);
+	module.size = size;
+	module.end = module.base + size;
+	snprintf(module.path, sizeof(module.path), "%s", path);
+	snprintf(module.name, sizeof(module.name), "%s", strrchr(path, '/') ? strrchr(path, '/') + 1 : path);
+
+	return true;
+}
+
+static void usage(const char* exe)
+{
+	printf("Usage: %s [-e libmem|memhlp] [-r repeats] [-l logfile] <steamclient.so>\n", exe);
+	printf("  -e  Scanner engine to use (default: libmem)\n");
+	printf("  -r  Scan every pattern this many times and report min/avg times\n");
+	printf("  -l  Write MemHlp's log to this file instead of discarding it\n");
+}
+
+int main(int argc, char** argv)
+{
+	ScanEngine engine = ScanEngine::Libmem;
+	unsigned int repeats = 1;
+	const char* logPath = "/dev/null";
+
+	int opt;
+	while((opt = getopt(argc, argv, "e:r:l:h")) != -1)
+	{
+		switch(opt)
+		{
+			case 'e':
+				if (strcmp(optarg, "memhlp") == 0)
+					engine = ScanEngine::MemHlp;
+				else if (strcmp(optarg, "libmem") != 0)
+				{
+					fprintf(stderr, "Unknown engine %s!\n", optarg);
+					return 1;
+				}
+				break;
+
+			case 'r':
+				repeats = strtoul(optarg, nullptr, 10);
+				if (!repeats)
+					repeats = 1;
+				break;
+
+			case 'l':
+				logPath = optarg;
+				break;
+
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (optind >= argc)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	g_pLog = std::make_unique<CLog>(logPath);
+
+	lm_module_t module {};
+	if (!mapModule(argv[optind], module))
+	{
+		return 1;
+	}
+
+	const std::string buildId = MemHlp::getBuildId(module);
+	MemHlp::loadFunctionTable(module);
+	printf("%s: %u bytes, build-id %s\n", module.name, static_cast<unsigned int>(module.size), buildId.empty() ? "none" : buildId.c_str());
+	printf("Engine: %s, repeats: %u\n\n", engine == ScanEngine::MemHlp ? "memhlp" : "libmem", repeats);
+	printf("%-32s %7s %-6s %-10s %-16s %-10s %10s %10s\n", "Pattern", "Matches", "Unique", "Match", "Follow", "Target", "Min ms", "Avg ms");
+
+	bool allFound = true;
+	double totalMs = 0;
+	for(auto& site : Patterns::sites)
+	{
+		const MemHlp::CSignature sig(site.pattern);
+
+		lm_address_t match = LM_ADDRESS_BAD;
+		double minMs = 0, sumMs = 0;
+		for(unsigned int i = 0; i < repeats; i++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			match = scan(engine, site.pattern, sig, module.base, module.size);
+			const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			sumMs += ms;
+			if (i == 0 || ms < minMs)
+				minMs = ms;
+		}
+		totalMs += sumMs / repeats;
+
+		unsigned int matches = 0;
+		for(lm_address_t cur = match; cur != LM_ADDRESS_BAD; )
+		{
+			matches++;
+			cur = scan(engine, site.pattern, sig, cur + 1, module.end - cur - 1);
+		}
+
+		lm_address_t target = LM_ADDRESS_BAD;
+		if (match != LM_ADDRESS_BAD)
+		{
+			target = MemHlp::followSignature(site.name, match, site.followMode);
+		}
+
+		allFound &= target != LM_ADDRESS_BAD;
+
+		char matchStr[16] = "-", targetStr[16] = "-";
+		if (match != LM_ADDRESS_BAD)
+			snprintf(matchStr, sizeof(matchStr), "0x%x", static_cast<unsigned int>(match - module.base));
+		if (target != LM_ADDRESS_BAD)
+			snprintf(targetStr, sizeof(targetStr), "0x%x", static_cast<unsigned int>(target - module.base));
+		else if (match != LM_ADDRESS_BAD)
+			snprintf(targetStr, sizeof(targetStr), "failed");
+
+		printf
+		(
+			"%-32s %7u %-6s %-10s %-16s %-10s %10.3f %10.3f\n",
+			site.name,
+			matches,
+			matches == 1 ? "yes" : "no",
+			matchStr,
+			MemHlp::followModeToStr(site.followMode),
+			targetStr,
+			minMs,
+			sumMs / repeats
+		);
+	}
+
+	printf("\nTotal: %.3f ms per full pattern set\n", totalMs);
+
+	munmap(reinterpret_cast<void*>(module.base), module.size);
+	return allFound ? 0 : 2;
+}
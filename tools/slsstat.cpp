@@ -0,0 +1,268 @@
+//Live viewer for the stats page SLSsteam publishes with StatsPage: yes.
+//Only reads shared memory, so it never stops or slows down Steam itself
+
+#include "statspage.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//Same order as SigScanResult
+static const char* sigResultNames[StatsPage::SIG_RESULTS] =
+{
+	"Cached",
+	"Near",
+	"Far",
+	"Full",
+	"Missing"
+};
+
+//Same order as Memory::Subsystem
+static const char* memoryNames[StatsPage::MEMORY_SUBSYSTEMS] =
+{
+	"Log",
+	"Config",
+	"Hooks",
+	"Caches",
+	"Profiling"
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void onSignal(int)
+{
+	running = 0;
+}
+
+///Summary:
+///Returns the pid of the first live SLSsteam stats page in /dev/shm or 0
+static uint32_t findPid()
+{
+	DIR* dir = opendir("/dev/shm");
+	if (!dir)
+	{
+		return 0;
+	}
+
+	uint32_t pid = 0;
+	while(dirent* entry = readdir(dir))
+	{
+		unsigned int candidate;
+		if (sscanf(entry->d_name, "SLSsteam-%u", &candidate) != 1)
+			continue;
+
+		//Skip leftovers of crashed instances
+		char proc[32];
+		snprintf(proc, sizeof(proc), "/proc/%u", candidate);
+		if (access(proc, F_OK) == 0)
+		{
+			pid = candidate;
+			break;
+		}
+	}
+
+	closedir(dir);
+	return pid;
+}
+
+static const StatsPage::CLayout* attach(uint32_t pid)
+{
+	char path[64];
+	StatsPage::getPath(path, sizeof(path), pid);
+
+	int fd = shm_open(path, O_RDONLY | O_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Unable to open /dev/shm%s: %s\nIs StatsPage enabled in the config?\n", path, strerror(errno));
+		return nullptr;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(StatsPage::CLayout)))
+	{
+		fprintf(stderr, "/dev/shm%s is too small!\n", path);
+		close(fd);
+		return nullptr;
+	}
+
+	void* map = mmap(nullptr, sizeof(StatsPage::CLayout), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+	{
+		fprintf(stderr, "Unable to map /dev/shm%s!\n", path);
+		return nullptr;
+	}
+
+	const StatsPage::CLayout* page = reinterpret_cast<const StatsPage::CLayout*>(map);
+	if (page->magic != StatsPage::MAGIC || page->version != StatsPage::VERSION || page->size != sizeof(StatsPage::CLayout))
+	{
+		fprintf
+		(
+			stderr,
+			"/dev/shm%s has an unsupported layout (version %u, size %u)! Expected version %u, size %u\n",
+			path,
+			page->version,
+			page->size,
+			StatsPage::VERSION,
+			static_cast<unsigned int>(sizeof(StatsPage::CLayout))
+		);
+		munmap(map, sizeof(StatsPage::CLayout));
+		return nullptr;
+	}
+
+	return page;
+}
+
+static void print(const StatsPage::CLayout* page, const uint64_t* lastCalls, double interval, bool clear)
+{
+	if (clear)
+	{
+		printf("\033[H\033[2J");
+	}
+
+	printf("SLSsteam %u, config generation %u\n\n", page->pid, page->configGeneration.load(std::memory_order_relaxed));
+
+	const unsigned int hookCount = page->hookCount.load(std::memory_order_relaxed);
+	printf("%-36s %14s %12s\n", "Hook", "Calls", "Calls/s");
+	for(unsigned int i = 0; i < hookCount && i < StatsPage::MAX_HOOKS; i++)
+	{
+		const uint64_t calls = page->hooks[i].calls.load(std::memory_order_relaxed);
+		printf("%-36.36s %14llu %12.1f\n", page->hooks[i].name, static_cast<unsigned long long>(calls), (calls - lastCalls[i]) / interval);
+	}
+
+	printf("\nSignatures:");
+	for(unsigned int i = 0; i < StatsPage::SIG_RESULTS; i++)
+	{
+		printf(" %s=%llu", sigResultNames[i], static_cast<unsigned long long>(page->sigScans[i].load(std::memory_order_relaxed)));
+	}
+
+	printf
+	(
+		"\nHash cache: hits=%u misses=%u\n",
+		page->hashCacheHits.load(std::memory_order_relaxed),
+		page->hashCacheMisses.load(std::memory_order_relaxed)
+	);
+	printf
+	(
+		"Log: lines=%llu dropped once=%llu once evictions=%llu\n",
+		static_cast<unsigned long long>(page->logLines.load(std::memory_order_relaxed)),
+		static_cast<unsigned long long>(page->logOnceDropped.load(std::memory_order_relaxed)),
+		static_cast<unsigned long long>(page->logOnceEvictions.load(std::memory_order_relaxed))
+	);
+
+	printf("\n%-36s %14s %14s\n", "Memory", "Bytes", "Peak");
+	for(unsigned int i = 0; i < StatsPage::MEMORY_SUBSYSTEMS; i++)
+	{
+		printf
+		(
+			"%-36s %14llu %14llu\n",
+			memoryNames[i],
+			static_cast<unsigned long long>(page->memoryBytes[i].load(std::memory_order_relaxed)),
+			static_cast<unsigned long long>(page->memoryPeak[i].load(std::memory_order_relaxed))
+		);
+	}
+
+	const unsigned int phaseCount = page->phaseCount.load(std::memory_order_acquire);
+	printf("\nStartup: total=%.3fms\n", page->startupTotalNs / 1e6);
+	for(unsigned int i = 0; i < phaseCount && i < StatsPage::MAX_PHASES; i++)
+	{
+		printf("  %-44.44s %10.3fms\n", page->phases[i].name, page->phases[i].durationNs / 1e6);
+	}
+
+	fflush(stdout);
+}
+
+static void usage(const char* exe)
+{
+	printf("Usage: %s [-p pid] [-i seconds] [-n]\n", exe);
+	printf("  -p  Pid of the Steam process to attach to (default: first one found in /dev/shm)\n");
+	printf("  -i  Refresh interval in seconds (default: 1)\n");
+	printf("  -n  Print once and exit\n");
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t pid = 0;
+	double interval = 1;
+	bool once = false;
+
+	int opt;
+	while((opt = getopt(argc, argv, "p:i:nh")) != -1)
+	{
+		switch(opt)
+		{
+			case 'p':
+				pid = strtoul(optarg, nullptr, 10);
+				break;
+
+			case 'i':
+				interval = strtod(optarg, nullptr);
+				if (interval <= 0)
+					interval = 1;
+				break;
+
+			case 'n':
+				once = true;
+				break;
+
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (!pid)
+	{
+		pid = findPid();
+		if (!pid)
+		{
+			fprintf(stderr, "No running SLSsteam instance found. Is StatsPage enabled in the config?\n");
+			return 1;
+		}
+	}
+
+	const StatsPage::CLayout* page = attach(pid);
+	if (!page)
+	{
+		return 1;
+	}
+
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+
+	//Rates are relative to the previous refresh, so the first one shows totals per interval
+	uint64_t lastCalls[StatsPage::MAX_HOOKS] {};
+	while(running)
+	{
+		print(page, lastCalls, interval, !once);
+		if (once)
+			break;
+
+		for(unsigned int i = 0; i < StatsPage::MAX_HOOKS; i++)
+		{
+			lastCalls[i] = page->hooks[i].calls.load(std::memory_order_relaxed);
+		}
+
+		usleep(static_cast<useconds_t>(interval * 1e6));
+
+		//Page gets unlinked when steamclient.so unloads, our mapping stays valid though
+		char proc[32];
+		snprintf(proc, sizeof(proc), "/proc/%u", pid);
+		if (access(proc, F_OK) != 0)
+		{
+			printf("\nProcess %u exited\n", pid);
+			break;
+		}
+	}
+
+	munmap(const_cast<StatsPage::CLayout*>(page), sizeof(StatsPage::CLayout));
+	return 0;
+}